@@ -39,6 +39,48 @@
 /* FreeRTOS includes. */
 #include <FreeRTOS.h>
 
+#if !defined( _WIN32 )
+
+/* POSIX port, run time is counted in 1/100ths of a millisecond from the
+monotonic clock. */
+#include <time.h>
+
+static long long llInitialRunTimeCounterValue = 0LL;
+
+static long long prvHundredthsOfMillisecond( void )
+{
+struct timespec xNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &xNow );
+	return ( long long ) xNow.tv_sec * 100000LL + xNow.tv_nsec / 10000LL;
+}
+/*-----------------------------------------------------------*/
+
+void vConfigureTimerForRunTimeStats( void )
+{
+	llInitialRunTimeCounterValue = prvHundredthsOfMillisecond();
+}
+/*-----------------------------------------------------------*/
+
+unsigned long ulGetRunTimeCounterValue( void )
+{
+	return ( unsigned long ) ( prvHundredthsOfMillisecond() - llInitialRunTimeCounterValue );
+}
+/*-----------------------------------------------------------*/
+
+uint32_t ulGetEventBusTime( void )
+{
+struct timespec xNow;
+
+	/* Microseconds from the monotonic clock, wrapping at 32 bits.  The event
+	bus only takes differences of these, and reads them from ISRs too. */
+	clock_gettime( CLOCK_MONOTONIC, &xNow );
+	return ( uint32_t ) ( ( unsigned long long ) xNow.tv_sec * 1000000ULL + ( unsigned long long ) xNow.tv_nsec / 1000ULL );
+}
+/*-----------------------------------------------------------*/
+
+#else
+
 /* Variables used in the creation of the run time stats time base.  Run time
 stats record how much time each task spends in the Running state. */
 static long long llInitialRunTimeCounterValue = 0LL, llTicksPerHundedthMillisecond = 0LL;
@@ -96,3 +138,18 @@ unsigned long ulReturn;
 	return ulReturn;
 }
 /*-----------------------------------------------------------*/
+
+uint32_t ulGetEventBusTime( void )
+{
+LARGE_INTEGER liCurrentCount, liFrequency;
+
+	/* Microseconds from the performance counter, wrapping at 32 bits.  The
+	event bus only takes differences of these, and reads them from ISRs
+	too. */
+	QueryPerformanceFrequency( &liFrequency );
+	QueryPerformanceCounter( &liCurrentCount );
+	return ( uint32_t ) ( ( liCurrentCount.QuadPart / liFrequency.QuadPart ) * 1000000LL + ( liCurrentCount.QuadPart % liFrequency.QuadPart ) * 1000000LL / liFrequency.QuadPart );
+}
+/*-----------------------------------------------------------*/
+
+#endif /* _WIN32 */
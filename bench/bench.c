@@ -0,0 +1,272 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Erik Friesen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.h"
+#include "event_bus.h"
+#include <FreeRTOS.h>
+#include <queue.h>
+#include <stdlib.h>
+#include <string.h>
+#include <task.h>
+
+#if defined(EVENT_BENCH_TIME)
+/* Supplied by the build along with EVENT_BENCH_HZ */
+#elif defined(_WIN32)
+#include <windows.h>
+static uint32_t prvBenchNow(void) {
+  LARGE_INTEGER t;
+  (void)QueryPerformanceCounter(&t);
+  return (uint32_t)t.QuadPart;
+}
+static uint32_t prvBenchHz(void) {
+  LARGE_INTEGER f;
+  (void)QueryPerformanceFrequency(&f);
+  return (uint32_t)f.QuadPart;
+}
+#define EVENT_BENCH_TIME() prvBenchNow()
+#define EVENT_BENCH_HZ prvBenchHz()
+#elif defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) ||                \
+    defined(__ARM_ARCH_8M_MAIN__)
+/* DWT cycle counter, no CMSIS header needed */
+#define BENCH_DEMCR (*(volatile uint32_t *)0xE000EDFCUL)
+#define BENCH_DWT_CTRL (*(volatile uint32_t *)0xE0001000UL)
+#define BENCH_DWT_CYCCNT (*(volatile uint32_t *)0xE0001004UL)
+#define EVENT_BENCH_TIME() BENCH_DWT_CYCCNT
+#define EVENT_BENCH_HZ configCPU_CLOCK_HZ
+#define EVENT_BENCH_TIME_INIT()                                                \
+  do {                                                                         \
+    BENCH_DEMCR |= 1UL << 24;                                                  \
+    BENCH_DWT_CTRL |= 1UL;                                                     \
+  } while (0)
+#else
+#include <time.h>
+static uint32_t prvBenchNow(void) {
+  struct timespec ts;
+  (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+#define EVENT_BENCH_TIME() prvBenchNow()
+#define EVENT_BENCH_HZ 1000000000UL
+#endif
+
+#ifndef EVENT_BENCH_TIME_INIT
+#define EVENT_BENCH_TIME_INIT()
+#endif
+
+/* Clear of anything the unit tests use */
+#define BENCH_EVENT 0
+#define BENCH_IDLE_EVENT 1
+
+/* Payload bytes per pool class, the event_t header comes on top */
+#define POOL_X_SIZE(sz, ct) sz,
+static const uint32_t benchSizes[] = {EVENT_BUS_POOL_TABLE(POOL_X_SIZE)};
+#define BENCH_SIZES (sizeof(benchSizes) / sizeof(benchSizes[0]))
+
+static uint32_t samples[EVENT_BENCH_ITERS];
+static uint32_t releaseSamples[EVENT_BENCH_ITERS];
+static uint32_t benchHz;
+static volatile uint32_t benchCalls;
+static event_listener_t listeners[EVENT_BENCH_MAX_LISTENERS];
+static event_listener_t queueListener;
+static StaticQueue_t xQueueBuf;
+static uint8_t ucQueueStorage[sizeof(void *)];
+static event_t benchEvent;
+
+static void prvBenchCallback(event_t *ev) {
+  (void)ev;
+  benchCalls++;
+}
+
+static int prvCompare(const void *a, const void *b) {
+  uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+  return x < y ? -1 : x > y;
+}
+
+static uint32_t prvNs(uint64_t counts) {
+  return (uint32_t)(counts * 1000000000ULL / benchHz);
+}
+
+/* Sorts the samples in place and prints one result line */
+static void prvReport(const char *bench, uint32_t param, uint32_t n) {
+  uint64_t total = 0;
+  uint32_t i;
+  for (i = 0; i < n; i++) {
+    total += samples[i];
+  }
+  qsort(samples, n, sizeof(samples[0]), prvCompare);
+  EVENT_BENCH_PRINTF(
+      "{\"bench\":\"%s\",\"param\":%lu,\"iters\":%lu,\"min\":%lu,"
+      "\"p50\":%lu,\"p99\":%lu,\"max\":%lu,\"mean\":%lu,\"ops_per_s\":%lu}\n",
+      bench, (unsigned long)param, (unsigned long)n,
+      (unsigned long)prvNs(samples[0]), (unsigned long)prvNs(samples[n / 2]),
+      (unsigned long)prvNs(samples[(n * 99) / 100]),
+      (unsigned long)prvNs(samples[n - 1]), (unsigned long)prvNs(total / n),
+      (unsigned long)(total ? (uint64_t)n * benchHz / total : 0));
+}
+
+static void prvAttach(uint32_t count) {
+  uint32_t i;
+  for (i = 0; i < count; i++) {
+    memset(&listeners[i], 0, sizeof(listeners[i]));
+    listeners[i].callback = prvBenchCallback;
+    listeners[i].name = "BENCH";
+    attachBus(&listeners[i]);
+  }
+}
+
+static void prvDetach(uint32_t count) {
+  uint32_t i;
+  for (i = 0; i < count; i++) {
+    detachBus(&listeners[i]);
+    unSubEventAll(&listeners[i]);
+  }
+}
+
+/* Static event, publishEvent returns once every callback has run */
+static void prvTimePublish(const char *bench, uint32_t param) {
+  uint32_t i, start;
+  benchEvent.event = BENCH_EVENT;
+  for (i = 0; i < EVENT_BENCH_ITERS; i++) {
+    start = EVENT_BENCH_TIME();
+    publishEvent(&benchEvent, false);
+    samples[i] = EVENT_BENCH_TIME() - start;
+  }
+  prvReport(bench, param, EVENT_BENCH_ITERS);
+}
+
+/* One subscriber on the measured event, the rest on another ID */
+static void prvBenchListeners(void) {
+  uint32_t n, i;
+  for (n = 1; n <= EVENT_BENCH_MAX_LISTENERS; n *= 2) {
+    prvAttach(n);
+    subEvent(&listeners[0], BENCH_EVENT);
+    for (i = 1; i < n; i++) {
+      subEvent(&listeners[i], BENCH_IDLE_EVENT);
+    }
+    prvTimePublish("publish_vs_listeners", n);
+    prvDetach(n);
+  }
+}
+
+static void prvBenchSubscribers(void) {
+  uint32_t n, i;
+  for (n = 1; n <= EVENT_BENCH_MAX_LISTENERS; n *= 2) {
+    prvAttach(n);
+    for (i = 0; i < n; i++) {
+      subEvent(&listeners[i], BENCH_EVENT);
+    }
+    prvTimePublish("publish_vs_subscribers", n);
+    prvDetach(n);
+  }
+}
+
+/* Pool events, freed by the bus once the one callback returns */
+static void prvBenchPayload(void) {
+  uint32_t c, i, start;
+  event_t *ev;
+  prvAttach(1);
+  subEvent(&listeners[0], BENCH_EVENT);
+  for (c = 0; c < BENCH_SIZES; c++) {
+    for (i = 0; i < EVENT_BENCH_ITERS; i++) {
+      start = EVENT_BENCH_TIME();
+      ev = eventAlloc(sizeof(event_t) + benchSizes[c], BENCH_EVENT, 0);
+      memset(ev + 1, (int)i, benchSizes[c]);
+      publishEvent(ev, false);
+      samples[i] = EVENT_BENCH_TIME() - start;
+    }
+    prvReport("publish_vs_payload", benchSizes[c], EVENT_BENCH_ITERS);
+  }
+  prvDetach(1);
+}
+
+/*
+ * Call cost of publishEventFromISR, issued from task level so no board
+ * interrupt is needed. The bus drains the transport between bursts, a
+ * post that still finds it full is retried and not counted.
+ */
+#define BENCH_ISR_BURST (EVENT_BUS_MAX_CMD_QUEUE / 2)
+static void prvBenchISR(void) {
+  uint32_t i = 0, burst, start;
+  BaseType_t ok, woken = pdFALSE;
+  prvAttach(1);
+  subEvent(&listeners[0], BENCH_EVENT);
+  benchEvent.event = BENCH_EVENT;
+  while (i < EVENT_BENCH_ITERS) {
+    for (burst = 0; burst < BENCH_ISR_BURST && i < EVENT_BENCH_ITERS;
+         burst++) {
+      start = EVENT_BENCH_TIME();
+      ok = publishEventFromISR(&benchEvent, &woken);
+      samples[i] = EVENT_BENCH_TIME() - start;
+      if (ok != pdTRUE) {
+        break;
+      }
+      i++;
+    }
+    eventBusBarrier();
+  }
+  prvReport("isr_publish", BENCH_ISR_BURST, EVENT_BENCH_ITERS);
+  prvDetach(1);
+}
+
+/* Times the allocation and the final release separately */
+static void prvBenchAlloc(void) {
+  uint32_t c, i, start;
+  event_t *ev, *rx;
+  /* Static storage, so only created on the first run */
+  if (queueListener.queueHandle == NULL) {
+    queueListener.name = "BENCHQ";
+    queueListener.queueHandle =
+        xQueueCreateStatic(1, sizeof(void *), ucQueueStorage, &xQueueBuf);
+  }
+  for (c = 0; c < BENCH_SIZES; c++) {
+    for (i = 0; i < EVENT_BENCH_ITERS; i++) {
+      start = EVENT_BENCH_TIME();
+      ev = eventAlloc(sizeof(event_t) + benchSizes[c], BENCH_EVENT, 0);
+      samples[i] = EVENT_BENCH_TIME() - start;
+      (void)publishToListener(&queueListener, ev, portMAX_DELAY);
+      (void)xQueueReceive(queueListener.queueHandle, &rx, portMAX_DELAY);
+      start = EVENT_BENCH_TIME();
+      eventRelease(rx, &queueListener);
+      releaseSamples[i] = EVENT_BENCH_TIME() - start;
+    }
+    prvReport("alloc", benchSizes[c], EVENT_BENCH_ITERS);
+    memcpy(samples, releaseSamples, sizeof(samples));
+    prvReport("release", benchSizes[c], EVENT_BENCH_ITERS);
+  }
+}
+
+void eventBusBench(void) {
+  EVENT_BENCH_TIME_INIT();
+  benchHz = EVENT_BENCH_HZ;
+  EVENT_BENCH_PRINTF("{\"bench\":\"config\",\"hz\":%lu,\"lanes\":%d,"
+                     "\"direct\":%d,\"transport\":%d,\"max_cmd_queue\":%d}\n",
+                     (unsigned long)benchHz, EVENT_BUS_LANES,
+                     EVENT_BUS_DIRECT_DISPATCH, EVENT_BUS_CMD_TRANSPORT,
+                     EVENT_BUS_MAX_CMD_QUEUE);
+  prvBenchListeners();
+  prvBenchSubscribers();
+  prvBenchPayload();
+  prvBenchISR();
+  prvBenchAlloc();
+}
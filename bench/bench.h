@@ -0,0 +1,92 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Erik Friesen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef EVENTBUS_BENCH_H
+#define EVENTBUS_BENCH_H
+
+/*
+ * Benchmarks for the bus, one JSON object per line on EVENT_BENCH_PRINTF.
+ * Times are nanoseconds per operation, worked out from EVENT_BENCH_TIME
+ * and EVENT_BENCH_HZ. The simulator and Cortex-M3 and up have defaults,
+ * other targets define both, for example a hardware timer and its rate.
+ */
+
+#include <stdint.h>
+#include <FreeRTOS.h>
+
+/* 1 to have main.c run the benchmarks instead of the unit tests */
+#ifndef EVENT_BUS_BENCH
+#define EVENT_BUS_BENCH 0
+#endif
+
+/* Samples per measurement, each is one timed operation */
+#ifndef EVENT_BENCH_ITERS
+#define EVENT_BENCH_ITERS 1000
+#endif
+
+/* Largest listener and subscriber count the sweeps go up to */
+#ifndef EVENT_BENCH_MAX_LISTENERS
+#define EVENT_BENCH_MAX_LISTENERS 16
+#endif
+
+#ifndef EVENT_BENCH_PRINTF
+#include <stdio.h>
+#define EVENT_BENCH_PRINTF printf
+#endif
+
+/*
+ * Runs every benchmark from the calling task, after initEventBus and with
+ * the scheduler started. Attaches and detaches its own listeners, so the
+ * bus should be otherwise idle.
+ */
+void eventBusBench(void);
+
+/* 1 to have main.c run eventBusSoak, argv[1] overrides the event count */
+#ifndef EVENT_BUS_SOAK
+#define EVENT_BUS_SOAK 0
+#endif
+
+#ifndef EVENT_SOAK_EVENTS
+#define EVENT_SOAK_EVENTS 1000000UL
+#endif
+
+/* Publisher tasks, each cycling through sync, async and ISR publishes */
+#ifndef EVENT_SOAK_PUBLISHERS
+#define EVENT_SOAK_PUBLISHERS 4
+#endif
+
+/* Async pool events each publisher may have unreleased */
+#ifndef EVENT_SOAK_INFLIGHT
+#define EVENT_SOAK_INFLIGHT 8
+#endif
+
+/*
+ * Publishes events in total across the publishers and checks every one
+ * was delivered exactly once and every pool event came back. Progress and
+ * the result are JSON lines like the benchmarks. Same calling rules as
+ * eventBusBench, returns pdFAIL on a lost or duplicated event.
+ */
+BaseType_t eventBusSoak(uint32_t events);
+
+#endif /* EVENTBUS_BENCH_H */
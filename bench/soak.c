@@ -0,0 +1,185 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Erik Friesen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bench.h"
+#include "event_bus.h"
+#include <FreeRTOS.h>
+#include <queue.h>
+#include <task.h>
+
+/* One ID per publish path, clear of the unit tests and the benchmarks */
+enum { SOAK_SYNC = 8, SOAK_ASYNC, SOAK_ISR };
+
+#define SOAK_STACK 256
+#define SOAK_PROGRESS (1UL << 20)
+#define SOAK_QUEUE_LEN (EVENT_SOAK_PUBLISHERS * EVENT_SOAK_INFLIGHT)
+
+static event_listener_t soakCallback;
+static event_listener_t soakQueue;
+static StaticQueue_t xQueueBuf;
+static uint8_t ucQueueStorage[SOAK_QUEUE_LEN * sizeof(void *)];
+static StaticTask_t xTaskBuf[EVENT_SOAK_PUBLISHERS + 1];
+static StackType_t xStack[EVENT_SOAK_PUBLISHERS + 1][SOAK_STACK];
+
+static event_t syncEvents[EVENT_SOAK_PUBLISHERS];
+static event_t isrEvents[EVENT_SOAK_PUBLISHERS];
+static uint32_t perPublisher;
+static volatile uint32_t sent[EVENT_SOAK_PUBLISHERS];
+static volatile uint32_t asyncSent[EVENT_SOAK_PUBLISHERS];
+static volatile uint32_t received[EVENT_SOAK_PUBLISHERS];
+static volatile uint32_t released[EVENT_SOAK_PUBLISHERS];
+static volatile uint32_t finished;
+static volatile uint32_t total;
+
+/* Callbacks run on the bus task or, with direct dispatch, the publisher */
+static void prvCount(volatile uint32_t *counter) {
+  taskENTER_CRITICAL();
+  (*counter)++;
+  total++;
+  taskEXIT_CRITICAL();
+}
+
+static void prvSoakCallback(event_t *ev) {
+  configASSERT(ev->publisherId < EVENT_SOAK_PUBLISHERS);
+  prvCount(&received[ev->publisherId]);
+}
+
+static void prvReceiver(void *pvParameters) {
+  event_t *ev;
+  uint16_t id;
+  (void)pvParameters;
+  for (;;) {
+    if (xQueueReceive(soakQueue.queueHandle, &ev, portMAX_DELAY) == pdTRUE) {
+      id = ev->publisherId;
+      configASSERT(id < EVENT_SOAK_PUBLISHERS);
+      eventRelease(ev, &soakQueue);
+      prvCount(&received[id]);
+      taskENTER_CRITICAL();
+      released[id]++;
+      taskEXIT_CRITICAL();
+    }
+  }
+}
+
+static void prvPublisher(void *pvParameters) {
+  uint16_t id = (uint16_t)(uintptr_t)pvParameters;
+  TickType_t start = xTaskGetTickCount();
+  BaseType_t woken;
+  event_t *ev;
+  uint32_t i;
+  for (i = 0; i < perPublisher; i++) {
+    switch (i % 3) {
+    case 0:
+      publishEvent(&syncEvents[id], false);
+      break;
+    case 1:
+      /* Bounded so neither the pool nor the listener queue can run out */
+      while (asyncSent[id] - released[id] >= EVENT_SOAK_INFLIGHT) {
+        vTaskDelay(1);
+      }
+      ev = eventAlloc(sizeof(event_t), SOAK_ASYNC, id);
+      asyncSent[id]++;
+      (void)publishEventAsync(ev, NULL, portMAX_DELAY);
+      break;
+    default:
+      woken = pdFALSE;
+      while (publishEventFromISR(&isrEvents[id], &woken) != pdTRUE) {
+        vTaskDelay(1);
+      }
+      if (woken == pdTRUE) {
+        taskYIELD();
+      }
+      break;
+    }
+    sent[id]++;
+    if (id == 0 && (i + 1) % SOAK_PROGRESS == 0) {
+      TickType_t elapsed = xTaskGetTickCount() - start;
+      EVENT_BENCH_PRINTF("{\"soak\":\"progress\",\"delivered\":%lu,"
+                         "\"ms\":%lu}\n",
+                         (unsigned long)total,
+                         (unsigned long)(elapsed * portTICK_PERIOD_MS));
+    }
+  }
+  taskENTER_CRITICAL();
+  finished++;
+  taskEXIT_CRITICAL();
+  for (;;) {
+    vTaskDelay(portMAX_DELAY);
+  }
+}
+
+BaseType_t eventBusSoak(uint32_t events) {
+  TickType_t start;
+  uint32_t i, want = 0, got = 0;
+  BaseType_t result = pdPASS;
+
+  perPublisher = events / EVENT_SOAK_PUBLISHERS;
+  soakCallback.callback = prvSoakCallback;
+  soakCallback.name = "SOAK";
+  soakQueue.name = "SOAKQ";
+  soakQueue.queueHandle = xQueueCreateStatic(SOAK_QUEUE_LEN, sizeof(void *),
+                                             ucQueueStorage, &xQueueBuf);
+  attachBus(&soakCallback);
+  attachBus(&soakQueue);
+  subEvent(&soakCallback, SOAK_SYNC);
+  subEvent(&soakCallback, SOAK_ISR);
+  subEvent(&soakQueue, SOAK_ASYNC);
+
+  /* Above the publishers so the queue drains as fast as it fills */
+  (void)xTaskCreateStatic(prvReceiver, "SoakRX", SOAK_STACK, NULL, 3,
+                          xStack[EVENT_SOAK_PUBLISHERS],
+                          &xTaskBuf[EVENT_SOAK_PUBLISHERS]);
+  start = xTaskGetTickCount();
+  for (i = 0; i < EVENT_SOAK_PUBLISHERS; i++) {
+    syncEvents[i].event = SOAK_SYNC;
+    syncEvents[i].publisherId = (uint16_t)i;
+    isrEvents[i].event = SOAK_ISR;
+    isrEvents[i].publisherId = (uint16_t)i;
+    (void)xTaskCreateStatic(prvPublisher, "SoakPub", SOAK_STACK,
+                            (void *)(uintptr_t)i, 1, xStack[i], &xTaskBuf[i]);
+  }
+  while (finished < EVENT_SOAK_PUBLISHERS) {
+    vTaskDelay(10);
+  }
+  eventBusBarrier();
+  for (i = 0; i < EVENT_SOAK_PUBLISHERS; i++) {
+    while (released[i] != asyncSent[i]) {
+      vTaskDelay(1);
+    }
+  }
+  for (i = 0; i < EVENT_SOAK_PUBLISHERS; i++) {
+    want += sent[i];
+    got += received[i];
+    if (received[i] != sent[i]) {
+      result = pdFAIL;
+    }
+  }
+  EVENT_BENCH_PRINTF("{\"soak\":\"%s\",\"sent\":%lu,\"delivered\":%lu,"
+                     "\"ms\":%lu}\n",
+                     result == pdPASS ? "pass" : "fail", (unsigned long)want,
+                     (unsigned long)got,
+                     (unsigned long)((xTaskGetTickCount() - start) *
+                                     portTICK_PERIOD_MS));
+  return result;
+}
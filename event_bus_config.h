@@ -5,21 +5,70 @@
 
 #define EVENT_BUS_RTOS_PRIORITY (configMAX_PRIORITIES - 2)
 
-#define EVENT_BUS_POOL_SM_SZ 32
-#define EVENT_BUS_POOL_SM_CT 128
+/* Guarded settings can be overridden on the command line, CMake builds the
+   test variants that way */
 
-#define EVENT_BUS_POOL_MD_SZ 128
-#define EVENT_BUS_POOL_MD_CT 64
-
-#define EVENT_BUS_POOL_LG_SZ 384
-#define EVENT_BUS_POOL_LG_CT 32
+/* X(payload bytes, block count), ascending, up to 7 classes */
+#define EVENT_BUS_POOL_TABLE(X)                                                \
+  X(16, 64)                                                                    \
+  X(37, 16)                                                                    \
+  X(48, 128)                                                                   \
+  X(96, 64)                                                                    \
+  X(1024, 8)
+#ifndef EVENT_BUS_POOL_LOCKFREE
+#define EVENT_BUS_POOL_LOCKFREE 1
+#endif
+#ifndef EVENT_BUS_POOL_CACHE_SZ
+#define EVENT_BUS_POOL_CACHE_SZ 8
+#endif
 
+#ifndef EVENT_BUS_MAX_CMD_QUEUE
 #define EVENT_BUS_MAX_CMD_QUEUE 32
+#endif
+#ifndef EVENT_BUS_LANES
+#define EVENT_BUS_LANES 2
+#endif
+/* EVENT_BUS_TRANSPORT_RING for the lock-free command ring */
+#ifndef EVENT_BUS_CMD_TRANSPORT
+#define EVENT_BUS_CMD_TRANSPORT EVENT_BUS_TRANSPORT_QUEUE
+#endif
+#ifndef EVENT_BUS_CACHE_LINE
+#define EVENT_BUS_CACHE_LINE 32
+#endif
+#ifndef EVENT_BUS_MASK_WIDTH
 #define EVENT_BUS_MASK_WIDTH 3
+#endif
+#ifndef EVENT_BUS_MAX_SUBSCRIPTIONS
+#define EVENT_BUS_MAX_SUBSCRIPTIONS 192
+#endif
+#ifndef EVENT_BUS_DIRECT_DISPATCH
+#define EVENT_BUS_DIRECT_DISPATCH 0
+#endif
+#ifndef EVENT_BUS_HIST
+#define EVENT_BUS_HIST 1
+#endif
+#ifndef EVENT_BUS_STATS
+#define EVENT_BUS_STATS 1
+#endif
+#ifndef EVENT_BUS_TRACE
+#define EVENT_BUS_TRACE 1
+#endif
+#ifndef EVENT_BUS_TRACE_SIZE
+#define EVENT_BUS_TRACE_SIZE 64
+#endif
+#ifndef EVENT_BUS_WORKERS
+#define EVENT_BUS_WORKERS 2
+#endif
 
 #define EVENT_BUS_DEBUG_QUEUE_FULL(name) configASSERT(0)
+#ifndef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
 #define EVENT_BUS_USE_TASK_NOTIFICATION_INDEX 1
+#endif
 
-#define EVENT_BUS_TIME_SOURCE xTaskGetTickCount()
+/* Microseconds, see Run-time-stats-utils.c. Ticks would put every latency in
+   histogram bucket 0, a Cortex-M target would use DWT->CYCCNT with
+   EVENT_BUS_TIME_DIV_US set to the core clock in MHz */
+uint32_t ulGetEventBusTime(void);
+#define EVENT_BUS_TIME_SOURCE ulGetEventBusTime()
 
 #endif
\ No newline at end of file
@@ -26,16 +26,26 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include "bench/bench.h"
 #include "minunit.h"
 
 /* Kernel includes. */
 #include "event_bus.h"
+#include "event_bridge.h"
 #include <FreeRTOS.h>
 #include <queue.h>
 #include <semphr.h>
 #include <task.h>
 #include <timers.h>
 
+#if !defined(_WIN32)
+/* FreeRTOS POSIX port, see CMakeLists.txt */
+#include <unistd.h>
+#define ExitProcess(code) exit(code)
+#define Sleep(ms) usleep((ms)*1000)
+#endif
+
 #define CMD_QUEUE_SIZE 4
 static StaticQueue_t xStaticQueue;
 static uint8_t ucQueueStorage[CMD_QUEUE_SIZE * sizeof(void *)];
@@ -44,10 +54,15 @@ static QueueHandle_t xQueueTest = NULL;
 static StaticQueue_t xStaticQueue2;
 static uint8_t ucQueueStorage2[CMD_QUEUE_SIZE * sizeof(void *)];
 static QueueHandle_t xQueueTest2 = NULL;
+static TaskHandle_t busTask = NULL;
 
 enum { EVENT_1, EVENT_2, EVENT_3, EVENT_4 };
 enum { CALLBACK_1, CALLBACK_2, CALLBACK_3, CALLBACK_4 };
 
+#if EVENT_BUS_SOAK == 1
+static uint32_t soakEvents = EVENT_SOAK_EVENTS;
+#endif
+
 static StackType_t xStackTest[512];
 static StaticTask_t xTaskBufferTest;
 static uint32_t results[CALLBACK_4 + 1];
@@ -121,10 +136,10 @@ void test_setup(void) {
   detachBus(&ev2);
   detachBus(&ev3);
   detachBus(&ev4);
-  memset(ev1.eventMask, 0, sizeof(ev1.eventMask));
-  memset(ev2.eventMask, 0, sizeof(ev2.eventMask));
-  memset(ev3.eventMask, 0, sizeof(ev3.eventMask));
-  memset(ev4.eventMask, 0, sizeof(ev4.eventMask));
+  unSubEventAll(&ev1);
+  unSubEventAll(&ev2);
+  unSubEventAll(&ev3);
+  unSubEventAll(&ev4);
 }
 
 static const char *test_pubSub(void) {
@@ -150,32 +165,134 @@ static const char *test_pubSubRange(void) {
   static char info[64];
   test_setup();
   attachBus(&ev1);
+#if EVENT_BUS_SPARSE != 1
   for (i = 0; i < EVENT_BUS_BITS; i++) {
     subEvent(&ev1, i);
   }
+#endif
   for (i = 0; i < EVENT_BUS_BITS; i++) {
+#if EVENT_BUS_SPARSE == 1
+    /* Fewer records than IDs, each one is freed for the next */
+    subEvent(&ev1, i);
+#endif
     publishEventQ(i, 0xAAAA0000 + i);
     sprintf(info, "error, publish %i failed 0x%X != 0x%X", i,
             eventResult[i] , 0xAAAA0000 + i);
     mu_assert(info, eventResult[i] == 0xAAAA0000 + i);
+#if EVENT_BUS_SPARSE == 1
+    unSubEvent(&ev1, i);
+#endif
   }
   return NULL;
 }
 
+static const char *test_subMaskRange(void) {
+  int i;
+  test_setup();
+  attachBus(&ev1);
+#if EVENT_BUS_SPARSE != 1
+  uint32_t mask[EVENT_BUS_MASK_WIDTH] = {0};
+  mask[0] = (1UL << EVENT_2);
+  mask[EVENT_BUS_MASK_WIDTH - 1] = 0x80000000UL;
+  subEventMask(&ev1, mask);
+#else
+  subEvent(&ev1, EVENT_2);
+  subEvent(&ev1, EVENT_BUS_BITS - 1);
+#endif
+  subEventRange(&ev1, 40, 70);
+  for (i = 0; i < EVENT_BUS_BITS; i++) {
+    publishEventQ(i, 0x5500 + i);
+  }
+  mu_assert("error, mask EVENT_2 missed", eventResult[EVENT_2] == 0x5500 + EVENT_2);
+  mu_assert("error, mask top bit missed",
+            eventResult[EVENT_BUS_BITS - 1] == 0x5500 + EVENT_BUS_BITS - 1);
+  mu_assert("error, range start missed", eventResult[40] == 0x5500 + 40);
+  mu_assert("error, range end missed", eventResult[70] == 0x5500 + 70);
+  mu_assert("error, outside range delivered",
+            eventResult[EVENT_1] == 0 && eventResult[39] == 0 &&
+                eventResult[71] == 0);
+  return NULL;
+}
+
 static const char *test_pubFromISR(void) {
   event_value_t t = {.e = {.event = EVENT_1}, .value = 0xBEEF};
   test_setup();
   attachBus(&ev1);
   subEvent(&ev1, EVENT_1);
-  (void)publishEventFromISR(&t.e);
+  BaseType_t woken = pdFALSE;
+  (void)publishEventFromISR(&t.e, &woken);
+  mu_assert("error, bus task not flagged for yield", woken == pdTRUE);
   vTaskDelay(10);
   mu_assert("error, retain results != 0xBEEF", results[CALLBACK_1] == 0xBEEF);
   return NULL;
 }
 
+static volatile uint32_t stageHeld, stageGate;
+
+static void stageHoldCallback(event_t *ev) {
+  (void)ev;
+  stageHeld = 1;
+  while (!stageGate) {
+    vTaskDelay(1);
+  }
+}
+
+static const char *test_isrStage(void) {
+  static event_t *storage[4];
+  static event_isr_stage_t stage = EVENT_ISR_STAGE_INIT(storage);
+  static event_value_t t[5];
+  static event_value_t hold = {.e = {.event = EVENT_1}};
+  event_listener_t holder = {.callback = stageHoldCallback, .name = "HOLD"};
+  int i;
+  test_setup();
+  attachBus(&holder);
+  subEvent(&holder, EVENT_1);
+  attachBus(&ev1);
+  subEvent(&ev1, EVENT_2);
+  for (i = 0; i < 5; i++) {
+    t[i].e.event = EVENT_2;
+    t[i].value = 0x5700 + i;
+  }
+  /* Park the bus in a callback so the stage can fill up */
+  stageHeld = stageGate = 0;
+  (void)publishEventFromISR(&hold.e, NULL);
+  while (!stageHeld) {
+    vTaskDelay(1);
+  }
+  for (i = 0; i < 4; i++) {
+    mu_assert("error, stage push failed",
+              publishEventStaged(&stage, &t[i].e, NULL) == pdTRUE);
+  }
+  mu_assert("error, full stage accepted event",
+            publishEventStaged(&stage, &t[4].e, NULL) == pdFALSE);
+  stageGate = 1;
+  vTaskDelay(10);
+  mu_assert("error, staged events not drained", eventResult[EVENT_2] == 0x5703);
+  mu_assert("error, stage not empty", stage.head == stage.tail);
+  detachBus(&holder);
+  unSubEventAll(&holder);
+  return NULL;
+}
+
+#if EVENT_BUS_POOL_LOCKFREE == 1
+static const char *test_allocFromISR(void) {
+  test_setup();
+  attachBus(&ev1);
+  subEvent(&ev1, EVENT_2);
+  event_value_t *tx = eventAllocFromISR(sizeof(event_value_t), EVENT_2, 0);
+  mu_assert("error, ISR alloc failed", tx != NULL);
+  tx->value = 0x15A;
+  (void)publishEventFromISR(&tx->e, NULL);
+  vTaskDelay(10);
+  mu_assert("error, ISR alloc event != 0x15A", eventResult[EVENT_2] == 0x15A);
+  return NULL;
+}
+#endif
+
 static const char *test_retain(void) {
+  /* Stays retained after the test returns */
+  static event_value_t t = {.e = {.event = EVENT_1}, .value = 0x1234};
   test_setup();
-  event_value_t t = {.e = {.event = EVENT_1}, .value = 0x1234};
   attachBus(&ev1);
   publishEvent(&t.e, true);
   subEvent(&ev1, EVENT_1);
@@ -215,7 +332,7 @@ static const char *test_subscribeArray(void) {
 }
 
 static const char *test_detachBus(void) {
-  event_value_t t = {.e = {.event = EVENT_1}, .value = 0x4321};
+  static event_value_t t = {.e = {.event = EVENT_1}, .value = 0x4321};
   test_setup();
   results[CALLBACK_1] = 0x1111;
   attachBus(&ev1);
@@ -226,6 +343,33 @@ static const char *test_detachBus(void) {
   return NULL;
 }
 
+static const char *test_subscriberIndex(void) {
+  event_value_t t2 = {.e = {.event = EVENT_2}, .value = 0xE2};
+  test_setup();
+  attachBus(&ev1);
+  attachBus(&ev2);
+  subEvent(&ev1, EVENT_1);
+  subEvent(&ev2, EVENT_2);
+  subEvent(&ev2, EVENT_2); /* Duplicate must not double deliver */
+  publishEvent(&t2.e, false);
+  mu_assert("error, index ev1 got EVENT_2", results[CALLBACK_1] == 0);
+  mu_assert("error, index ev2 != 0xE2", results[CALLBACK_2] == 0xE2);
+  /* Subscriptions survive a detach / attach cycle */
+  detachBus(&ev2);
+  results[CALLBACK_2] = 0;
+  publishEvent(&t2.e, false);
+  mu_assert("error, index detached ev2 called", results[CALLBACK_2] == 0);
+  attachBus(&ev2);
+  publishEvent(&t2.e, false);
+  mu_assert("error, index reattached ev2 != 0xE2",
+            results[CALLBACK_2] == 0xE2);
+  unSubEvent(&ev2, EVENT_2);
+  results[CALLBACK_2] = 0;
+  publishEvent(&t2.e, false);
+  mu_assert("error, index unSub ev2 called", results[CALLBACK_2] == 0);
+  return NULL;
+}
+
 static const char *test_filterRX(void) {
   event_value_t t1 = {.e = {.event = EVENT_1}, .value = 0xE1};
   event_value_t t2 = {.e = {.event = EVENT_2}, .value = 0xE2};
@@ -297,6 +441,37 @@ static const char *test_waitEventFail(void) {
   return NULL;
 }
 
+static const char *test_waitEventRetained(void) {
+  static event_value_t t = {.e = {.event = EVENT_3}, .value = 0x3E};
+  test_setup();
+  publishEvent(&t.e, true);
+  mu_assert("error, retained event didn't end wait",
+            waitEvent(EVENT_3, 0) == pdPASS);
+  /* Waiter left the index, a plain publish must not touch it */
+  publishEventQ(EVENT_3, 0);
+  mu_assert("error, second wait != pdFAIL", waitEvent(EVENT_3, 10) == pdFAIL);
+  return NULL;
+}
+
+#if EVENT_BUS_SPARSE == 1
+/* Waits and unsubscribes on every ID must leave no records behind */
+static const char *test_sparseRecords(void) {
+  uint32_t i;
+  test_setup();
+  attachBus(&ev1);
+  for (i = 0; i < EVENT_BUS_BITS; i++) {
+    (void)waitEvent(i, 0);
+    subEvent(&ev1, i);
+    unSubEvent(&ev1, i);
+  }
+  subEvent(&ev1, EVENT_BUS_BITS - 1);
+  publishEventQ(EVENT_BUS_BITS - 1, 0x5EC0);
+  mu_assert("error, sparse record not reused",
+            eventResult[EVENT_BUS_BITS - 1] == 0x5EC0);
+  return NULL;
+}
+#endif
+
 static const char *test_queueRX(void) {
   static TimerHandle_t xTimer;
   static StaticTimer_t xTimerBuffer;
@@ -371,10 +546,813 @@ static const char *test_AllocatedEvent(void) {
   printf("\r\nEvent Pool info\r\n\r\n");
   pLen = eventPoolInfo(pBuf, sizeof(pBuf));
   printf(pBuf);
+  printf("\r\nEvent Batch info\r\n\r\n");
+  pLen = eventBatchInfo(pBuf, sizeof(pBuf));
+  printf(pBuf);
   printf("\r\n");
   return NULL;
 }
 
+static volatile uint32_t asyncCompleted;
+
+static void asyncComplete(event_t *ev) {
+  asyncCompleted = ((event_value_t *)ev)->value;
+}
+
+static const char *test_publishAsync(void) {
+  test_setup();
+  asyncCompleted = 0;
+  attachBus(&ev1);
+  subEvent(&ev1, EVENT_2);
+  event_value_t *tx = eventAlloc(sizeof(event_value_t), EVENT_2, 0);
+  tx->value = 0xA5;
+  mu_assert("error, async publish not queued",
+            publishEventAsync(&tx->e, asyncComplete, portMAX_DELAY) == pdPASS);
+  /* Plain publish is a barrier, the async one is ahead of it in the queue */
+  publishEventQ(EVENT_3, 0);
+  mu_assert("error, async event != 0xA5", eventResult[EVENT_2] == 0xA5);
+  mu_assert("error, async complete != 0xA5", asyncCompleted == 0xA5);
+  return NULL;
+}
+
+static const char *test_batchDrain(void) {
+  int i;
+  test_setup();
+  attachBus(&ev1);
+  subEvent(&ev1, EVENT_3);
+  for (i = 0; i < 4; i++) {
+    event_value_t *tx = eventAlloc(sizeof(event_value_t), EVENT_3, 0);
+    tx->value = 0xB1 + i;
+    publishEventAsync(&tx->e, NULL, portMAX_DELAY);
+  }
+  /* Queued behind the burst, so this returns after the whole batch */
+  publishEventQ(EVENT_4, 0);
+  mu_assert("error, batch last event != 0xB4", eventResult[EVENT_3] == 0xB4);
+  return NULL;
+}
+
+static void *extReleased;
+
+static void extRelease(void *data, void *ctx) {
+  (void)ctx;
+  extReleased = data;
+}
+
+static const char *test_externalBuffer(void) {
+  static uint8_t frame[2048];
+  test_setup();
+  extReleased = NULL;
+  attachBus(&ev1);
+  subEvent(&ev1, EVENT_3);
+  event_ext_t *ext =
+      eventAllocExt(EVENT_3, 0, frame, sizeof(frame), extRelease, NULL);
+  publishEvent(&ext->e, false);
+  mu_assert("error, external buffer not released", extReleased == frame);
+  return NULL;
+}
+
+static event_listener_t lateJoiner = {.callback = callback2, .name = "LATE"};
+
+static void joinCallback(event_t *ev) {
+  (void)ev;
+  /* Blocking calls here would deadlock the bus */
+  (void)attachBusAsync(&lateJoiner, 0);
+  (void)subEventAsync(&lateJoiner, EVENT_2, 0);
+}
+
+static const char *test_asyncSubscribe(void) {
+  event_listener_t joiner = {.callback = joinCallback, .name = "JOIN"};
+  test_setup();
+  attachBus(&joiner);
+  subEvent(&joiner, EVENT_1);
+  publishEventQ(EVENT_1, 0);
+  publishEventQ(EVENT_2, 0xA5);
+  mu_assert("error, async subscribe missed next event",
+            results[CALLBACK_2] == 0xA5);
+  mu_assert("error, detachBusAsync failed", detachBusAsync(&lateJoiner, 0));
+  eventBusBarrier();
+  publishEventQ(EVENT_2, 0x5A);
+  mu_assert("error, delivered after async detach", results[CALLBACK_2] == 0xA5);
+  detachBus(&joiner);
+  unSubEventAll(&joiner);
+  unSubEventAll(&lateJoiner);
+  return NULL;
+}
+
+static void *retainedData;
+
+static void retainCallback(event_t *ev) {
+  retainedData = ((event_ext_t *)ev)->data;
+}
+
+static const char *test_retainDynamic(void) {
+  static uint8_t first[4], second[4];
+  event_listener_t late = {.callback = retainCallback, .name = "RET"};
+  event_t *ev;
+  test_setup();
+  extReleased = NULL;
+  ev = &eventAllocExt(EVENT_3, 0, first, sizeof(first), extRelease, NULL)->e;
+  publishEvent(ev, true);
+  mu_assert("error, retained event freed", extReleased == NULL);
+  attachBus(&late);
+  subEvent(&late, EVENT_3);
+  mu_assert("error, late subscriber missed retained event",
+            retainedData == first);
+  ev = &eventAllocExt(EVENT_3, 0, second, sizeof(second), extRelease, NULL)->e;
+  publishEvent(ev, true);
+  mu_assert("error, replaced event not released", extReleased == first);
+  invalidateEvent(ev);
+  mu_assert("error, invalidated event not released", extReleased == second);
+  detachBus(&late);
+  unSubEventAll(&late);
+  return NULL;
+}
+
+#if EVENT_BUS_LANES > 1
+static volatile uint32_t laneGate;
+static uint32_t laneOrder[4];
+static uint32_t laneOrderCount;
+static volatile uint32_t laneSeen;
+static volatile TickType_t laneSlow;
+
+static void laneCallback(event_t *ev) {
+  if (ev->event == EVENT_2) {
+    /* Hold the bus so the rest queue up behind this one */
+    while (!laneGate) {
+      vTaskDelay(1);
+    }
+    return;
+  }
+  laneSeen++;
+  vTaskDelay(laneSlow);
+  if (laneOrderCount < 4) {
+    laneOrder[laneOrderCount++] = ev->event;
+  }
+}
+
+static void laneOpen(TimerHandle_t xTimer) {
+  (void)xTimer;
+  laneGate = 1;
+}
+
+static const char *test_priorityLanes(void) {
+  static const uint32_t subs[] = {EVENT_2, EVENT_3, EVENT_4,
+                                  EVENT_BUS_LAST_PARAM};
+  event_listener_t evLane = {.callback = laneCallback, .name = "LANE"};
+  int i;
+  test_setup();
+  laneGate = 0;
+  laneOrderCount = 0;
+  eventSetLane(EVENT_4, 0);
+  attachBus(&evLane);
+  subEventList(&evLane, subs);
+  publishEventAsync(eventAlloc(sizeof(event_t), EVENT_2, 0), NULL,
+                    portMAX_DELAY);
+  for (i = 0; i < 3; i++) {
+    publishEventAsync(eventAlloc(sizeof(event_t), EVENT_3, 0), NULL,
+                      portMAX_DELAY);
+  }
+  publishEventAsync(eventAlloc(sizeof(event_t), EVENT_4, 0), NULL,
+                    portMAX_DELAY);
+  laneGate = 1;
+  /* Lanes are not ordered against each other, flush the low one first */
+  publishEventQ(EVENT_1, 0);
+  detachBus(&evLane);
+  eventSetLane(EVENT_4, EVENT_BUS_LANES - 1);
+  mu_assert("error, lane events missing", laneOrderCount == 4);
+  mu_assert("error, high lane not first", laneOrder[0] == EVENT_4);
+  return NULL;
+}
+
+static const char *test_barrierLanes(void) {
+  static TimerHandle_t xTimer;
+  static StaticTimer_t xTimerBuffer;
+  static const uint32_t subs[] = {EVENT_2, EVENT_3, EVENT_BUS_LAST_PARAM};
+  event_listener_t evLane = {.callback = laneCallback, .name = "LANE"};
+  uint32_t i;
+  test_setup();
+  xTimer = xTimerCreateStatic("Gate", 50 / portTICK_PERIOD_MS, pdFALSE,
+                              (void *)0, laneOpen, &xTimerBuffer);
+  laneGate = 0;
+  laneOrderCount = 0;
+  laneSeen = 0;
+  /* Slow enough that the batch after the gate cannot hide the last one */
+  laneSlow = 2;
+  attachBus(&evLane);
+  subEventList(&evLane, subs);
+  publishEventAsync(eventAlloc(sizeof(event_t), EVENT_2, 0), NULL,
+                    portMAX_DELAY);
+  /* A full low lane, more than the bus takes in one batch */
+  for (i = 0; i < EVENT_BUS_MAX_CMD_QUEUE; i++) {
+    publishEventAsync(eventAlloc(sizeof(event_t), EVENT_3, 0), NULL,
+                      portMAX_DELAY);
+  }
+  /* The gate opens with the barrier already queued */
+  xTimerStart(xTimer, 0);
+  eventBusBarrier();
+  laneSlow = 0;
+  mu_assert("error, barrier passed queued low lane events",
+            laneSeen == EVENT_BUS_MAX_CMD_QUEUE);
+  xTimerStop(xTimer, 0);
+  detachBus(&evLane);
+  return NULL;
+}
+#endif
+
+static const char *test_publishBatch(void) {
+  static event_value_t batch[3] = {{.e = {.event = EVENT_2}, .value = 0xB0},
+                                   {.e = {.event = EVENT_3}, .value = 0xB1},
+                                   {.e = {.event = EVENT_2}, .value = 0xB2}};
+  event_t *const evs[] = {&batch[0].e, &batch[1].e, &batch[2].e};
+  test_setup();
+  attachBus(&ev1);
+  subEvent(&ev1, EVENT_2);
+  subEvent(&ev1, EVENT_3);
+  publishEventBatch(evs, 3);
+  mu_assert("error, batch EVENT_3 != 0xB1", eventResult[EVENT_3] == 0xB1);
+  mu_assert("error, batch order, EVENT_2 != 0xB2",
+            eventResult[EVENT_2] == 0xB2);
+  return NULL;
+}
+
+static const char *test_ringBatch(void) {
+  static event_t *slots[8];
+  static event_ring_t ring = EVENT_RING_INIT(slots);
+  event_listener_t evRing = {.ring = &ring, .name = "RING"};
+  event_t *rx[8];
+  size_t n;
+  int i;
+  test_setup();
+  attachBus(&evRing);
+  subEvent(&evRing, EVENT_3);
+  mu_assert("error, empty ring returned events",
+            eventReceiveBatch(&evRing, rx, 8, 0) == 0);
+  for (i = 0; i < 5; i++) {
+    event_value_t *tx = eventAlloc(sizeof(event_value_t), EVENT_3, 0);
+    tx->value = 0xE0 + i;
+    publishEvent(&tx->e, false);
+  }
+  n = eventReceiveBatch(&evRing, rx, 8, portMAX_DELAY);
+  detachBus(&evRing);
+  mu_assert("error, ring batch count != 5", n == 5);
+  mu_assert("error, ring batch order",
+            ((event_value_t *)rx[0])->value == 0xE0 &&
+                ((event_value_t *)rx[4])->value == 0xE4);
+  eventReleaseBatch(rx, n, &evRing);
+  mu_assert("error, ring events still held", evRing.refCount == 0);
+  return NULL;
+}
+
+static TaskHandle_t nudgeTask;
+static volatile uint32_t nudges;
+
+/* Wakes the ring owner without pushing anything, until nudges run out */
+static void nudgeCallback(TimerHandle_t xTimer) {
+  if (nudges > 0) {
+    nudges--;
+    xTaskNotifyGiveIndexed(nudgeTask, EVENT_BUS_RING_NOTIFY_INDEX);
+    xTimerStart(xTimer, 0);
+  }
+}
+
+static const char *test_ringTimeout(void) {
+  static event_t *slots[4];
+  static event_ring_t ring = EVENT_RING_INIT(slots);
+  static TimerHandle_t xTimer;
+  static StaticTimer_t xTimerBuffer;
+  event_listener_t evRing = {.ring = &ring, .name = "RING"};
+  event_t *rx[4];
+  TickType_t start, waited;
+  test_setup();
+  xTimer = xTimerCreateStatic("Nudge", 20 / portTICK_PERIOD_MS, pdFALSE,
+                              (void *)0, nudgeCallback, &xTimerBuffer);
+  nudgeTask = xTaskGetCurrentTaskHandle();
+  nudges = 10;
+  attachBus(&evRing);
+  xTimerStart(xTimer, 0);
+  start = xTaskGetTickCount();
+  mu_assert("error, nudged ring returned events",
+            eventReceiveBatch(&evRing, rx, 4, 100 / portTICK_PERIOD_MS) == 0);
+  waited = xTaskGetTickCount() - start;
+  nudges = 0;
+  xTimerStop(xTimer, 0);
+  detachBus(&evRing);
+  vTaskDelay(40 / portTICK_PERIOD_MS);
+  (void)ulTaskNotifyTakeIndexed(EVENT_BUS_RING_NOTIFY_INDEX, pdTRUE, 0);
+  /* Each wakeup used to start the full timeout over */
+  mu_assert("error, ring timeout restarted on wakeup",
+            waited >= 100 / portTICK_PERIOD_MS &&
+                waited < 180 / portTICK_PERIOD_MS);
+  return NULL;
+}
+
+static const char *test_bridgeLoopback(void) {
+  static uint32_t shmMem[(sizeof(event_bridge_shm_t) + 256) / 4];
+  static event_bridge_shm_link_t link;
+  static const event_bridge_transport_t shmLink =
+      EVENT_BRIDGE_SHM_TRANSPORT(&link);
+  static const event_bridge_route_t routes[] = {
+      {EVENT_4, sizeof(event_value_t)}};
+  static event_t *slots[8];
+  static event_bridge_t tx = {.routes = routes,
+                              .routeCount = 1,
+                              .transport = &shmLink,
+                              .mtu = 64,
+                              .ring = EVENT_RING_INIT(slots),
+                              .name = "BRIDGE"};
+  static event_bridge_t rx = {0};
+  static StaticQueue_t xQueueBuf;
+  static uint8_t ucStorage[4 * sizeof(void *)];
+  static event_listener_t evRemote = {.name = "REMOTE"};
+  event_value_t *got[2] = {NULL, NULL};
+  static const uint8_t junk[3] = {0x45, 1, 0};
+  int i;
+  test_setup();
+  link.shm = eventBridgeShmInit(shmMem, sizeof(shmMem));
+  eventBridgeStart(&tx);
+  for (i = 0; i < 2; i++) {
+    event_value_t *ev = eventAlloc(sizeof(event_value_t), EVENT_4, 7);
+    ev->value = 0xD0 + i;
+    publishEvent(&ev->e, false);
+  }
+  mu_assert("error, bridge flushed != 2",
+            eventBridgeFlush(&tx, portMAX_DELAY) == 2);
+  mu_assert("error, bridge frames != 1", tx.txFrames == 1);
+  /* Only the far side may see EVENT_4 from here on, or it would loop */
+  eventBridgeStop(&tx);
+  mu_assert("error, bridge events still held", tx.listener.refCount == 0);
+
+  evRemote.queueHandle =
+      xQueueCreateStatic(4, sizeof(void *), ucStorage, &xQueueBuf);
+  attachBus(&evRemote);
+  subEvent(&evRemote, EVENT_4);
+  rx.lowWater = 0xFFFF;
+  mu_assert("error, low pool frame not refused",
+            eventBridgeShmPoll(&link, &rx) == 0 && rx.rxRefused == 1);
+  rx.lowWater = 0;
+  mu_assert("error, refused frame not retried",
+            eventBridgeShmPoll(&link, &rx) == 1);
+  for (i = 0; i < 2; i++) {
+    xQueueReceive(evRemote.queueHandle, &got[i], 5000 / portTICK_PERIOD_MS);
+  }
+  detachBus(&evRemote);
+  unSubEventAll(&evRemote);
+  mu_assert("error, bridged events missing", got[0] && got[1]);
+  mu_assert("error, bridged payload",
+            got[0]->value == 0xD0 && got[1]->value == 0xD1);
+  mu_assert("error, bridged publisherId", got[0]->e.publisherId == 7);
+  eventRelease(&got[0]->e, &evRemote);
+  eventRelease(&got[1]->e, &evRemote);
+  mu_assert("error, bridge sequence gap", rx.rxLost == 0);
+  mu_assert("error, short frame accepted",
+            eventBridgeReceive(&rx, junk, sizeof(junk)) == pdFAIL);
+
+  /* Nobody polls, so the link fills and flush gives up on the last one */
+  eventBridgeStart(&tx);
+  for (i = 0; i < 16 && tx.txDropped == 0; i++) {
+    event_value_t *ev = eventAlloc(sizeof(event_value_t), EVENT_4, 7);
+    ev->value = 0xD4;
+    publishEvent(&ev->e, false);
+    (void)eventBridgeFlush(&tx, portMAX_DELAY);
+  }
+  eventBridgeStop(&tx);
+  mu_assert("error, stalled link not counted", tx.txDropped == 1);
+  mu_assert("error, stalled link dropped a sent frame", tx.txFrames == (uint32_t)i);
+  while (eventBridgeShmPoll(&link, &rx) != 0) {
+  }
+  return NULL;
+}
+
+static const char *test_conflate(void) {
+  static StaticQueue_t xQueueBuf;
+  static uint8_t ucStorage[CMD_QUEUE_SIZE * sizeof(void *)];
+  event_listener_t evSlow = {.name = "SLOW"};
+  event_value_t *rx;
+  int i;
+  test_setup();
+  evSlow.queueHandle =
+      xQueueCreateStatic(CMD_QUEUE_SIZE, sizeof(void *), ucStorage, &xQueueBuf);
+  attachBus(&evSlow);
+  subEventConflated(&evSlow, EVENT_3);
+  /* Nobody reads, the queue would overflow without conflation */
+  for (i = 0; i < CMD_QUEUE_SIZE * 2; i++) {
+    event_value_t *tx = eventAlloc(sizeof(event_value_t), EVENT_3, 0);
+    tx->value = 0xC0 + i;
+    publishEvent(&tx->e, false);
+  }
+  detachBus(&evSlow);
+  mu_assert("error, conflated queue depth != 1",
+            uxQueueMessagesWaiting(evSlow.queueHandle) == 1);
+  xQueueReceive(evSlow.queueHandle, &rx, 0);
+  mu_assert("error, conflated value not newest",
+            rx->value == 0xC0 + CMD_QUEUE_SIZE * 2 - 1);
+  eventRelease(&rx->e, &evSlow);
+  mu_assert("error, superseded events still held", evSlow.refCount == 0);
+  return NULL;
+}
+
+static void publishValue(uint32_t event, uint32_t value) {
+  event_value_t *tx = eventAlloc(sizeof(event_value_t), event, 0);
+  tx->value = value;
+  publishEvent(&tx->e, false);
+}
+
+/* Empties the listener queue into vals, returns how many were pending */
+static int drainValues(event_listener_t *listener, uint32_t *vals) {
+  event_value_t *rx;
+  int n = 0;
+  while (xQueueReceive(listener->queueHandle, &rx, 0) == pdTRUE) {
+    vals[n++] = rx->value;
+    eventRelease(&rx->e, listener);
+  }
+  return n;
+}
+
+static const char *test_overflowPolicies(void) {
+  static StaticQueue_t xQueueBuf;
+  static uint8_t ucStorage[2 * sizeof(void *)];
+  /* Static, the slow BLOCK release leaves it in the response stats */
+  static event_listener_t evFull = {.name = "FULL"};
+  uint32_t vals[4];
+  TickType_t start;
+  test_setup();
+  evFull.queueHandle =
+      xQueueCreateStatic(2, sizeof(void *), ucStorage, &xQueueBuf);
+  evFull.overflow = EVENT_OVERFLOW_DROP_NEWEST;
+  attachBus(&evFull);
+  subEvent(&evFull, EVENT_3);
+  subEvent(&evFull, EVENT_4);
+  publishValue(EVENT_3, 0xA0);
+  publishValue(EVENT_3, 0xA1);
+  publishValue(EVENT_3, 0xA2);
+  mu_assert("error, drop newest kept wrong events",
+            drainValues(&evFull, vals) == 2 && vals[0] == 0xA0 &&
+                vals[1] == 0xA1 && evFull.errFull);
+#if EVENT_BUS_STATS == 1
+  mu_assert("error, drop newest not counted", evFull.dropped == 1);
+#endif
+
+  evFull.overflow = EVENT_OVERFLOW_DROP_OLDEST;
+  publishValue(EVENT_3, 0xB0);
+  publishValue(EVENT_3, 0xB1);
+  publishValue(EVENT_3, 0xB2);
+  mu_assert("error, drop oldest kept wrong events",
+            drainValues(&evFull, vals) == 2 && vals[0] == 0xB1 &&
+                vals[1] == 0xB2);
+
+  evFull.overflow = EVENT_OVERFLOW_CONFLATE;
+  publishValue(EVENT_3, 0xC0);
+  publishValue(EVENT_4, 0xC1);
+  publishValue(EVENT_3, 0xC2);
+  mu_assert("error, overflow conflate kept wrong events",
+            drainValues(&evFull, vals) == 2 && vals[0] == 0xC2 &&
+                vals[1] == 0xC1);
+
+  evFull.overflow = EVENT_OVERFLOW_BLOCK;
+  evFull.overflowWait = 20;
+  publishValue(EVENT_3, 0xD0);
+  publishValue(EVENT_3, 0xD1);
+  start = xTaskGetTickCount();
+  publishValue(EVENT_3, 0xD2);
+  mu_assert("error, block did not wait",
+            xTaskGetTickCount() - start >= evFull.overflowWait);
+  mu_assert("error, block kept wrong events",
+            drainValues(&evFull, vals) == 2 && vals[1] == 0xD1);
+  detachBus(&evFull);
+  unSubEventAll(&evFull);
+  mu_assert("error, overflowed events still held", evFull.refCount == 0);
+  return NULL;
+}
+
+static volatile uint32_t poolLowCalls;
+static volatile bool poolLow;
+
+static void onPoolLow(size_t blockSize, bool low) {
+  (void)blockSize;
+  poolLowCalls++;
+  poolLow = low;
+}
+
+static const char *test_poolLowWater(void) {
+  static event_t *held[128];
+  uint32_t free, n = 0, i;
+  test_setup();
+  free = eventPoolFree(sizeof(event_value_t));
+  mu_assert("error, pool too large for test", free > 2 && free <= 128);
+  eventPoolSetLowWater(sizeof(event_value_t), free - 2, onPoolLow);
+  held[n++] = eventTryAlloc(sizeof(event_value_t), EVENT_1, 0);
+  mu_assert("error, low water too early", poolLowCalls == 0);
+  held[n++] = eventTryAlloc(sizeof(event_value_t), EVENT_1, 0);
+  mu_assert("error, low water not reported", poolLowCalls == 1 && poolLow);
+  while (n < 128 &&
+         (held[n] = eventTryAlloc(sizeof(event_value_t), EVENT_1, 0)) != NULL) {
+    n++;
+  }
+  mu_assert("error, try alloc did not exhaust pool",
+            n == free && eventPoolFree(sizeof(event_value_t)) == 0);
+  /* Nobody listens to EVENT_1, so each publish frees its event */
+  for (i = 0; i < n; i++) {
+    publishEvent(held[i], false);
+  }
+  eventBusBarrier();
+  mu_assert("error, recovery not reported", poolLowCalls == 2 && !poolLow);
+  eventPoolSetLowWater(sizeof(event_value_t), 0, NULL);
+  return NULL;
+}
+
+static const char *test_oddPoolClass(void) {
+  static event_t *held[16];
+  const size_t size = sizeof(event_t) + 37;
+  uint32_t n = 0, i;
+  test_setup();
+  while (n < 16 && (held[n] = eventTryAlloc(size, EVENT_1, 0)) != NULL) {
+    mu_assert("error, odd class block misaligned",
+              ((uintptr_t)held[n] & 7) == 0);
+    n++;
+  }
+  mu_assert("error, odd class not allocated", n > 1);
+  for (i = 0; i < n; i++) {
+    publishEvent(held[i], false);
+  }
+  eventBusBarrier();
+  return NULL;
+}
+
+static bool oddValue(const event_t *ev, void *ctx) {
+  (void)ctx;
+  return (((const event_value_t *)ev)->value & 1) != 0;
+}
+
+static const char *test_filteredSub(void) {
+  static StaticQueue_t xQueueBuf;
+  static uint8_t ucStorage[4 * sizeof(void *)];
+  static event_listener_t evFilt = {.name = "FILTER"};
+  static event_filter_t above =
+      EVENT_FILTER_FIELD(event_value_t, value, EVENT_FILTER_GT, 100);
+  static event_filter_t negative = EVENT_FILTER_FIELD(
+      event_value_t, value, EVENT_FILTER_LT | EVENT_FILTER_SIGNED, 0);
+  static event_filter_t odd = {.match = oddValue};
+  uint32_t vals[4];
+  test_setup();
+  evFilt.queueHandle =
+      xQueueCreateStatic(4, sizeof(void *), ucStorage, &xQueueBuf);
+  attachBus(&evFilt);
+  subEventFiltered(&evFilt, EVENT_3, &above);
+  subEventFiltered(&evFilt, EVENT_4, &odd);
+  publishValue(EVENT_3, 5);
+  publishValue(EVENT_3, 150);
+  publishValue(EVENT_3, 100);
+  publishValue(EVENT_3, 101);
+  mu_assert("error, field filter passed wrong events",
+            drainValues(&evFilt, vals) == 2 && vals[0] == 150 &&
+                vals[1] == 101);
+  publishValue(EVENT_4, 1);
+  publishValue(EVENT_4, 2);
+  publishValue(EVENT_4, 3);
+  mu_assert("error, predicate filter passed wrong events",
+            drainValues(&evFilt, vals) == 2 && vals[0] == 1 && vals[1] == 3);
+  /* Replaces the filter on the same subscription */
+  subEventFiltered(&evFilt, EVENT_3, &negative);
+  publishValue(EVENT_3, 5);
+  publishValue(EVENT_3, (uint32_t)-5);
+  mu_assert("error, signed filter passed wrong events",
+            drainValues(&evFilt, vals) == 1 && vals[0] == (uint32_t)-5);
+  mu_assert("error, filtered events still held", evFilt.refCount == 0);
+  unSubEvent(&evFilt, EVENT_3);
+  mu_assert("error, unsubscribe kept the filter",
+            evFilt.filters == &odd && odd.next == NULL);
+  detachBus(&evFilt);
+  unSubEventAll(&evFilt);
+  mu_assert("error, filters left after unsubscribe", evFilt.filters == NULL);
+  return NULL;
+}
+
+#if EVENT_BUS_WORKERS > 0
+static volatile TaskHandle_t workerRan;
+static volatile uint32_t workerValues[8];
+static volatile uint32_t workerCalls;
+
+static void workerCallback(event_t *ev) {
+  workerRan = xTaskGetCurrentTaskHandle();
+  /* Blocking is fine here, only this worker waits */
+  vTaskDelay(2);
+  workerValues[workerCalls++] = ((event_value_t *)ev)->value;
+}
+
+static const char *test_workerCallbacks(void) {
+  static event_listener_t evWork = {
+      .callback = workerCallback, .worker = 1, .name = "WORK"};
+  int i;
+  test_setup();
+  workerRan = NULL;
+  workerCalls = 0;
+  attachBus(&evWork);
+  subEvent(&evWork, EVENT_3);
+  for (i = 0; i < 3; i++) {
+    publishValue(EVENT_3, 0xF0 + i);
+  }
+  eventWorkerFlush();
+  mu_assert("error, worker callbacks missing", workerCalls == 3);
+  mu_assert("error, worker callbacks out of order",
+            workerValues[0] == 0xF0 && workerValues[2] == 0xF2);
+  mu_assert("error, callback not on a worker",
+            workerRan != NULL && workerRan != busTask &&
+                workerRan != xTaskGetCurrentTaskHandle());
+  mu_assert("error, worker events still held", evWork.refCount == 0);
+  /* Static events are not deferred, publish may reuse them at once */
+  publishEventQ(EVENT_3, 0xF5);
+  eventBusBarrier();
+  mu_assert("error, static event deferred",
+            workerCalls == 4 && workerValues[3] == 0xF5 &&
+                (workerRan == busTask ||
+                 workerRan == xTaskGetCurrentTaskHandle()));
+  publishValue(EVENT_3, 0xF3);
+  /* detachBus waits for the worker, no flush needed */
+  detachBus(&evWork);
+  unSubEventAll(&evWork);
+  mu_assert("error, detach did not wait for worker", workerCalls == 5);
+  return NULL;
+}
+#endif
+
+#if EVENT_BUS_HIST == 1
+static uint32_t histCount(const volatile uint32_t *hist) {
+  uint32_t i, n = 0;
+  for (i = 0; i < EVENT_BUS_HIST_BUCKETS; i++) {
+    n += hist[i];
+  }
+  return n;
+}
+
+static const char *test_latencyHist(void) {
+  static StaticQueue_t xQueueBuf;
+  static uint8_t ucStorage[CMD_QUEUE_SIZE * sizeof(void *)];
+  static event_hist_t before, after, again, mine;
+  event_listener_t evHist = {.name = "HIST", .hist = &mine};
+  event_value_t *rx;
+  test_setup();
+  memset(&mine, 0, sizeof(mine));
+  evHist.queueHandle =
+      xQueueCreateStatic(CMD_QUEUE_SIZE, sizeof(void *), ucStorage, &xQueueBuf);
+  attachBus(&evHist);
+  subEvent(&evHist, EVENT_4);
+  mu_assert("error, no histogram for EVENT_4",
+            eventHistSnapshot(EVENT_4, &before) == pdPASS);
+  event_value_t *tx = eventAlloc(sizeof(event_value_t), EVENT_4, 0);
+  (void)publishEventAsync(&tx->e, NULL, portMAX_DELAY);
+  mu_assert("error, hist event not received",
+            xQueueReceive(evHist.queueHandle, &rx, 1000) == pdTRUE);
+  eventRelease(&rx->e, &evHist);
+  /* The dispatch phase lands after the push, let the bus finish it */
+  eventBusBarrier();
+  (void)eventHistSnapshot(EVENT_4, &after);
+  mu_assert("error, queue phase not counted",
+            histCount(after.queue) == histCount(before.queue) + 1);
+  mu_assert("error, dispatch phase not counted",
+            histCount(after.dispatch) == histCount(before.dispatch) + 1);
+  mu_assert("error, hold phase not counted",
+            histCount(after.hold) == histCount(before.hold) + 1);
+  mu_assert("error, listener histogram not counted",
+            histCount(mine.dispatch) == 1 && histCount(mine.hold) == 1);
+  (void)eventHistSnapshot(EVENT_4, &again);
+  /* Sparse builds free the record with its histogram on the unsubscribe */
+  detachBus(&evHist);
+  unSubEventAll(&evHist);
+  mu_assert("error, snapshot reset the histogram",
+            memcmp(&after, &again, sizeof(after)) == 0);
+  return NULL;
+}
+#endif
+
+#if EVENT_BUS_STATS == 1
+static const char *test_statsSnapshot(void) {
+  static StaticQueue_t xQueueBuf;
+  static uint8_t ucStorage[CMD_QUEUE_SIZE * sizeof(void *)];
+  static event_stats_t before, after;
+  event_listener_t evStats = {.name = "STATS"};
+  event_listener_stats_t ls;
+  event_bus_stats_t bus;
+  event_value_t *rx[2];
+  uint32_t i;
+  test_setup();
+  evStats.queueHandle =
+      xQueueCreateStatic(CMD_QUEUE_SIZE, sizeof(void *), ucStorage, &xQueueBuf);
+  attachBus(&evStats);
+  subEvent(&evStats, EVENT_4);
+  mu_assert("error, no stats for EVENT_4",
+            eventStatsSnapshot(EVENT_4, &before) == pdPASS);
+  for (i = 0; i < 2; i++) {
+    event_value_t *tx = eventAlloc(sizeof(event_value_t), EVENT_4, 0);
+    (void)publishEventAsync(&tx->e, NULL, portMAX_DELAY);
+  }
+  for (i = 0; i < 2; i++) {
+    mu_assert("error, stats event not received",
+              xQueueReceive(evStats.queueHandle, &rx[i], 1000) == pdTRUE);
+  }
+  /* Counters land after the push, let the bus finish the dispatch */
+  eventBusBarrier();
+  eventListenerStats(&evStats, &ls);
+  mu_assert("error, delivered not counted", ls.delivered == 2);
+  mu_assert("error, nothing dropped", ls.dropped == 0);
+  mu_assert("error, in flight not counted", ls.inFlight == 2);
+  for (i = 0; i < 2; i++) {
+    eventRelease(&rx[i]->e, &evStats);
+  }
+  eventListenerStats(&evStats, &ls);
+  mu_assert("error, released events still in flight", ls.inFlight == 0);
+  /* Before the unsubscribe, sparse builds free the record with its stats */
+  (void)eventStatsSnapshot(EVENT_4, &after);
+  detachBus(&evStats);
+  unSubEventAll(&evStats);
+  mu_assert("error, publishes not counted",
+            after.publishes == before.publishes + 2);
+  eventBusStats(&bus);
+  mu_assert("error, lane 0 high water not kept", bus.laneHighWater[0] >= 1);
+  mu_assert("error, high water above queue size",
+            bus.laneHighWater[0] <= EVENT_BUS_MAX_CMD_QUEUE);
+  mu_assert("error, lane 0 commands not counted", bus.laneCommands[0] > 0);
+  return NULL;
+}
+#endif
+
+#if EVENT_BUS_TRACE == 1
+static const char *test_traceRing(void) {
+  static StaticQueue_t xQueueBuf;
+  static uint8_t ucStorage[CMD_QUEUE_SIZE * sizeof(void *)];
+  static event_trace_rec_t recs[EVENT_BUS_TRACE_SIZE];
+  event_listener_t evTrace = {.name = "TRACE"};
+  uint32_t cursor = 0, end, n, i, seen = 0;
+  uint32_t evAddr, lAddr = (uint32_t)(uintptr_t)&evTrace;
+  event_value_t *rx;
+  test_setup();
+  evTrace.queueHandle =
+      xQueueCreateStatic(CMD_QUEUE_SIZE, sizeof(void *), ucStorage, &xQueueBuf);
+  attachBus(&evTrace);
+  subEvent(&evTrace, EVENT_4);
+  /* Skip whatever earlier tests left behind */
+  while (eventTraceRead(&cursor, recs, EVENT_BUS_TRACE_SIZE) != 0) {
+  }
+  event_value_t *tx = eventAlloc(sizeof(event_value_t), EVENT_4, 0);
+  evAddr = (uint32_t)(uintptr_t)tx;
+  (void)publishEventAsync(&tx->e, NULL, portMAX_DELAY);
+  mu_assert("error, trace event not received",
+            xQueueReceive(evTrace.queueHandle, &rx, 1000) == pdTRUE);
+  eventRelease(&rx->e, &evTrace);
+  eventBusBarrier();
+  detachBus(&evTrace);
+  unSubEventAll(&evTrace);
+  n = eventTraceRead(&cursor, recs, EVENT_BUS_TRACE_SIZE);
+  for (i = 0; i < n; i++) {
+    if (recs[i].event != evAddr || recs[i].eventId != EVENT_4) {
+      continue;
+    }
+    if (recs[i].type == EVENT_TRACE_PUBLISH && seen == 0) {
+      seen = 1;
+    } else if (recs[i].type == EVENT_TRACE_DELIVER && seen == 1 &&
+               recs[i].listener == lAddr) {
+      seen = 2;
+    } else if (recs[i].type == EVENT_TRACE_RELEASE && seen == 2 &&
+               recs[i].listener == lAddr) {
+      seen = 3;
+    }
+    if (i > 0) {
+      mu_assert("error, trace sequence gap",
+                recs[i].seq == (uint8_t)(recs[i - 1].seq + 1));
+    }
+  }
+  mu_assert("error, publish/deliver/release not traced in order", seen == 3);
+  /* A stale cursor resumes at the oldest record still held */
+  end = cursor;
+  cursor -= EVENT_BUS_TRACE_SIZE * 2;
+  n = eventTraceRead(&cursor, recs, EVENT_BUS_TRACE_SIZE);
+  mu_assert("error, stale cursor not clamped",
+            n == EVENT_BUS_TRACE_SIZE && cursor == end);
+  return NULL;
+}
+#endif
+
+#if EVENT_BUS_DIRECT_DISPATCH == 1
+static TaskHandle_t directTask;
+
+static void directCallback(event_t *ev) {
+  (void)ev;
+  directTask = xTaskGetCurrentTaskHandle();
+}
+
+static const char *test_directDispatch(void) {
+  event_listener_t evDirect = {.callback = directCallback, .name = "DIR"};
+  test_setup();
+  directTask = NULL;
+  attachBus(&evDirect);
+  subEvent(&evDirect, EVENT_4);
+  publishEventQ(EVENT_4, 0xD1);
+  detachBus(&evDirect);
+  mu_assert("error, direct callback not in publisher",
+            directTask == xTaskGetCurrentTaskHandle());
+  return NULL;
+}
+#endif
+
 static const char *test_StaticMsg(void) {
   static event_value_t msg = {.e = {.event = EVENT_1}, .value = 0xEF};
   event_value_t *tx = &msg;
@@ -393,15 +1371,58 @@ static const char *all_tests() {
   mu_run_test(test_pubSub);
   mu_run_test(test_pubSubHighBits);
   mu_run_test(test_pubSubRange);
+  mu_run_test(test_subMaskRange);
   mu_run_test(test_pubFromISR);
+  mu_run_test(test_isrStage);
+#if EVENT_BUS_POOL_LOCKFREE == 1
+  mu_run_test(test_allocFromISR);
+#endif
   mu_run_test(test_retain);
   mu_run_test(test_invalidate);
   mu_run_test(test_subscribeArray);
   mu_run_test(test_detachBus);
+  mu_run_test(test_subscriberIndex);
   mu_run_test(test_filterRX);
   mu_run_test(test_multipleRX);
+  mu_run_test(test_publishAsync);
+  mu_run_test(test_batchDrain);
+  mu_run_test(test_externalBuffer);
+  mu_run_test(test_retainDynamic);
+  mu_run_test(test_asyncSubscribe);
+  mu_run_test(test_publishBatch);
+  mu_run_test(test_conflate);
+  mu_run_test(test_overflowPolicies);
+  mu_run_test(test_poolLowWater);
+  mu_run_test(test_oddPoolClass);
+  mu_run_test(test_filteredSub);
+#if EVENT_BUS_WORKERS > 0
+  mu_run_test(test_workerCallbacks);
+#endif
+  mu_run_test(test_ringBatch);
+  mu_run_test(test_ringTimeout);
+  mu_run_test(test_bridgeLoopback);
+#if EVENT_BUS_LANES > 1
+  mu_run_test(test_priorityLanes);
+  mu_run_test(test_barrierLanes);
+#endif
+#if EVENT_BUS_HIST == 1
+  mu_run_test(test_latencyHist);
+#endif
+#if EVENT_BUS_STATS == 1
+  mu_run_test(test_statsSnapshot);
+#endif
+#if EVENT_BUS_TRACE == 1
+  mu_run_test(test_traceRing);
+#endif
+#if EVENT_BUS_DIRECT_DISPATCH == 1
+  mu_run_test(test_directDispatch);
+#endif
   mu_run_test(test_waitEvent);
   mu_run_test(test_waitEventFail);
+  mu_run_test(test_waitEventRetained);
+#if EVENT_BUS_SPARSE == 1
+  mu_run_test(test_sparseRecords);
+#endif
   mu_run_test(test_queueRX);
   mu_run_test(test_AllocatedEvent);
   mu_run_test(test_StaticMsg);
@@ -412,6 +1433,12 @@ static void TestTask(void *pvParameters) {
   static int i = 0;
   (void)pvParameters;
 
+#if EVENT_BUS_BENCH == 1
+  eventBusBench();
+  ExitProcess(0);
+#elif EVENT_BUS_SOAK == 1
+  ExitProcess(eventBusSoak(soakEvents) != pdPASS);
+#endif
   const char *result = all_tests();
   if (result != NULL) {
     printf("%s\n", result);
@@ -426,6 +1453,11 @@ static void TestTask(void *pvParameters) {
  *
  */
 int main(int argc, char **argv) {
+#if EVENT_BUS_SOAK == 1
+  if (argc > 1) {
+    soakEvents = (uint32_t)strtoul(argv[1], NULL, 0);
+  }
+#endif
 
   (void)xTaskCreateStatic(TestTask, "Test something", 512, NULL, 1, xStackTest,
                           &xTaskBufferTest);
@@ -433,7 +1465,7 @@ int main(int argc, char **argv) {
                                  ucQueueStorage, &xStaticQueue);
   xQueueTest2 = xQueueCreateStatic(CMD_QUEUE_SIZE, sizeof(void *),
                                   ucQueueStorage2, &xStaticQueue2);
-  initEventBus();
+  busTask = initEventBus();
   vTaskStartScheduler();
   return (EXIT_SUCCESS);
 }
@@ -506,9 +1538,16 @@ void vAssertCalled(unsigned long ulLine, const char *const pcFileName) {
     the debugger to set ulSetToNonZeroInDebuggerToContinue to a non-zero
     value. */
     printf("vAssertCalled @ %s:%i\r\n", pcFileName, ulLine);
+#if !defined(_WIN32)
+    /* No debugger on a host CI run, fail the process instead of hanging */
+    fflush(stdout);
+    abort();
+#endif
     while (ulSetToNonZeroInDebuggerToContinue == 0) {
+#if defined(_WIN32)
       __asm NOP;
       __asm NOP;
+#endif
       Sleep(10);
     }
   }
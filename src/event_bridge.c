@@ -0,0 +1,320 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Erik Friesen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+/* Kernel includes. */
+#include <FreeRTOS.h>
+#include <task.h>
+#include "event_bridge.h"
+#include "event_bus_port.h"
+
+#define BRIDGE_MAGIC 0x45
+#define BRIDGE_VERSION 1
+#define SHM_MAGIC 0x45425348UL
+#define SHM_WRAP 0xFFFFFFFFUL
+#define SHM_ALIGN(n) (((n) + 3U) & ~3U)
+
+typedef enum {
+  RX_OK,
+  RX_BAD,
+  RX_REFUSED,
+} rx_result_t;
+
+static inline void prvPut16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static inline uint16_t prvGet16(const uint8_t *p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static const event_bridge_route_t *prvRoute(const event_bridge_t *bridge,
+                                            uint32_t eventId) {
+  for (uint32_t i = 0; i < bridge->routeCount; i++) {
+    if (bridge->routes[i].eventId == eventId) {
+      return &bridge->routes[i];
+    }
+  }
+  return NULL;
+}
+
+void eventBridgeStart(event_bridge_t *bridge) {
+  configASSERT(bridge);
+  configASSERT(bridge->transport);
+  configASSERT(bridge->mtu > EVENT_BRIDGE_HDR_SZ + EVENT_BRIDGE_REC_SZ);
+  memset(&bridge->listener, 0, sizeof(bridge->listener));
+  bridge->listener.ring = &bridge->ring;
+  bridge->listener.name = bridge->name ? bridge->name : "BRIDGE";
+  attachBus(&bridge->listener);
+  for (uint32_t i = 0; i < bridge->routeCount; i++) {
+    const event_bridge_route_t *r = &bridge->routes[i];
+    /* IDs and payload lengths travel as 16 bits */
+    configASSERT(r->eventId <= 0xFFFF);
+    configASSERT(r->size >= sizeof(event_t));
+    /* Every event has to fit a frame on its own */
+    configASSERT(EVENT_BRIDGE_HDR_SZ + EVENT_BRIDGE_REC_SZ + r->size -
+                     sizeof(event_t) <=
+                 bridge->mtu);
+    subEvent(&bridge->listener, r->eventId);
+  }
+}
+
+void eventBridgeStop(event_bridge_t *bridge) {
+  configASSERT(bridge);
+  detachBus(&bridge->listener);
+  unSubEventAll(&bridge->listener);
+  /* Hand back whatever was delivered but never flushed */
+  event_t *evs[EVENT_BRIDGE_BATCH];
+  size_t n;
+  while ((n = eventReceiveBatch(&bridge->listener, evs, EVENT_BRIDGE_BATCH,
+                                0)) != 0) {
+    eventReleaseBatch(evs, n, &bridge->listener);
+  }
+}
+
+static void prvFrameSend(event_bridge_t *bridge, uint8_t *frame, size_t len,
+                         uint8_t count) {
+  frame[0] = BRIDGE_MAGIC;
+  frame[1] = BRIDGE_VERSION;
+  frame[2] = count;
+  frame[3] = 0;
+  prvPut16(&frame[4], (uint16_t)len);
+  prvPut16(&frame[6], bridge->txSeq++);
+  bridge->transport->commit(bridge->transport->ctx, frame, len);
+  bridge->txFrames++;
+}
+
+size_t eventBridgeFlush(event_bridge_t *bridge, TickType_t xTicksToWait) {
+  const event_bridge_transport_t *t = bridge->transport;
+  event_t *evs[EVENT_BRIDGE_BATCH];
+  size_t n = eventReceiveBatch(&bridge->listener, evs, EVENT_BRIDGE_BATCH,
+                               xTicksToWait);
+  size_t sent = 0;
+  uint8_t *frame = NULL;
+  size_t len = 0;
+  uint8_t count = 0;
+  TickType_t txWait = EVENT_BRIDGE_TX_WAIT;
+
+  for (size_t i = 0; i < n; i++) {
+    const event_bridge_route_t *r = prvRoute(bridge, evs[i]->event);
+    if (r == NULL) {
+      continue;
+    }
+    size_t payload = r->size - sizeof(event_t);
+    size_t need = EVENT_BRIDGE_REC_SZ + payload;
+    if (frame != NULL && (len + need > bridge->mtu || count == UINT8_MAX)) {
+      prvFrameSend(bridge, frame, len, count);
+      frame = NULL;
+    }
+    if (frame == NULL) {
+      frame = t->reserve(t->ctx, bridge->mtu, txWait);
+      if (frame == NULL) {
+        /* A stalled link costs one wait per flush, not one per event */
+        txWait = 0;
+        bridge->txDropped++;
+        continue;
+      }
+      len = EVENT_BRIDGE_HDR_SZ;
+      count = 0;
+    }
+    uint8_t *rec = &frame[len];
+    prvPut16(&rec[0], (uint16_t)evs[i]->event);
+    prvPut16(&rec[2], evs[i]->publisherId);
+    prvPut16(&rec[4], (uint16_t)payload);
+    memcpy(&rec[EVENT_BRIDGE_REC_SZ], (const uint8_t *)evs[i] + sizeof(event_t),
+           payload);
+    len += need;
+    count++;
+    sent++;
+  }
+  if (frame != NULL) {
+    prvFrameSend(bridge, frame, len, count);
+  }
+  if (n != 0) {
+    eventReleaseBatch(evs, n, &bridge->listener);
+  }
+  return sent;
+}
+
+void eventBridgeTask(void *pvParameters) {
+  event_bridge_t *bridge = pvParameters;
+  for (;;) {
+    (void)eventBridgeFlush(bridge, portMAX_DELAY);
+  }
+}
+
+static rx_result_t prvReceive(event_bridge_t *bridge, const uint8_t *frame,
+                              size_t len) {
+  if (len < EVENT_BRIDGE_HDR_SZ || frame[0] != BRIDGE_MAGIC ||
+      frame[1] != BRIDGE_VERSION || prvGet16(&frame[4]) != len) {
+    bridge->rxErrors++;
+    return RX_BAD;
+  }
+  uint8_t count = frame[2];
+  uint16_t seq = prvGet16(&frame[6]);
+
+  /* Check the whole frame first, it is taken entirely or not at all */
+  size_t off = EVENT_BRIDGE_HDR_SZ;
+  for (uint8_t i = 0; i < count; i++) {
+    if (len - off < EVENT_BRIDGE_REC_SZ) {
+      bridge->rxErrors++;
+      return RX_BAD;
+    }
+    const uint8_t *rec = &frame[off];
+    size_t payload = prvGet16(&rec[4]);
+    if (prvGet16(&rec[0]) >= EVENT_BUS_BITS ||
+        len - off - EVENT_BRIDGE_REC_SZ < payload) {
+      bridge->rxErrors++;
+      return RX_BAD;
+    }
+    /* Conservative, as if every record drew from this record's class */
+    if (eventPoolFree(sizeof(event_t) + payload) <=
+        (uint32_t)bridge->lowWater + count) {
+      bridge->rxRefused++;
+      return RX_REFUSED;
+    }
+    off += EVENT_BRIDGE_REC_SZ + payload;
+  }
+  if (off != len) {
+    bridge->rxErrors++;
+    return RX_BAD;
+  }
+
+  off = EVENT_BRIDGE_HDR_SZ;
+  for (uint8_t i = 0; i < count; i++) {
+    const uint8_t *rec = &frame[off];
+    size_t payload = prvGet16(&rec[4]);
+    event_t *ev = eventTryAlloc(sizeof(event_t) + payload, prvGet16(&rec[0]),
+                                prvGet16(&rec[2]));
+    if (ev == NULL) {
+      /* Another task drained the pool after the check */
+      bridge->rxDropped += count - i;
+      break;
+    }
+    memcpy((uint8_t *)ev + sizeof(event_t), &rec[EVENT_BRIDGE_REC_SZ],
+           payload);
+    (void)publishEventAsync(ev, NULL, portMAX_DELAY);
+    off += EVENT_BRIDGE_REC_SZ + payload;
+  }
+  if (seq != bridge->rxSeq) {
+    bridge->rxLost += (uint16_t)(seq - bridge->rxSeq);
+  }
+  bridge->rxSeq = seq + 1;
+  bridge->rxFrames++;
+  return RX_OK;
+}
+
+BaseType_t eventBridgeReceive(event_bridge_t *bridge, const uint8_t *frame,
+                              size_t len) {
+  configASSERT(bridge);
+  configASSERT(frame);
+  return prvReceive(bridge, frame, len) == RX_OK ? pdPASS : pdFAIL;
+}
+
+static inline uint8_t *prvShmData(event_bridge_shm_t *shm) {
+  return (uint8_t *)(shm + 1);
+}
+
+event_bridge_shm_t *eventBridgeShmInit(void *mem, size_t bytes) {
+  configASSERT(mem);
+  configASSERT(((uintptr_t)mem & 3U) == 0);
+  configASSERT(bytes >= sizeof(event_bridge_shm_t) + 64);
+  event_bridge_shm_t *shm = mem;
+  /* Largest power of two that fits after the header */
+  uint32_t room = (uint32_t)(bytes - sizeof(event_bridge_shm_t));
+  shm->size = 0x80000000UL >> EVENT_BUS_CLZ(room);
+  shm->head = 0;
+  shm->tail = 0;
+  ebAtomicStore(&shm->magic, SHM_MAGIC);
+  return shm;
+}
+
+uint8_t *eventBridgeShmReserve(void *ctx, size_t len, TickType_t xTicksToWait) {
+  event_bridge_shm_link_t *link = ctx;
+  event_bridge_shm_t *shm = link->shm;
+  configASSERT(shm->magic == SHM_MAGIC);
+  uint32_t need = 4 + SHM_ALIGN((uint32_t)len);
+  configASSERT(need <= shm->size / 2);
+  TickType_t start = xTaskGetTickCount();
+
+  /* Only this side moves tail, the consumer only ever frees more room */
+  uint32_t tail = shm->tail;
+  uint32_t off = tail & (shm->size - 1);
+  link->skip = shm->size - off < need ? shm->size - off : 0;
+  while (shm->size - (tail - ebAtomicLoad(&shm->head)) < link->skip + need) {
+    if (xTaskGetTickCount() - start >= xTicksToWait) {
+      return NULL;
+    }
+    vTaskDelay(1);
+  }
+  return &prvShmData(shm)[((tail + link->skip) & (shm->size - 1)) + 4];
+}
+
+void eventBridgeShmCommit(void *ctx, uint8_t *frame, size_t len) {
+  event_bridge_shm_link_t *link = ctx;
+  event_bridge_shm_t *shm = link->shm;
+  uint8_t *data = prvShmData(shm);
+  uint32_t tail = shm->tail;
+  if (link->skip != 0) {
+    *(volatile uint32_t *)&data[tail & (shm->size - 1)] = SHM_WRAP;
+  }
+  configASSERT(frame == &data[((tail + link->skip) & (shm->size - 1)) + 4]);
+  *(volatile uint32_t *)(frame - 4) = (uint32_t)len;
+  /* Publishes the frame, the store orders everything written before it */
+  ebAtomicStore(&shm->tail,
+                tail + link->skip + 4 + SHM_ALIGN((uint32_t)len));
+  link->skip = 0;
+  if (link->notify) {
+    link->notify();
+  }
+}
+
+uint32_t eventBridgeShmPoll(event_bridge_shm_link_t *link,
+                            event_bridge_t *bridge) {
+  event_bridge_shm_t *shm = link->shm;
+  configASSERT(shm->magic == SHM_MAGIC);
+  uint8_t *data = prvShmData(shm);
+  uint32_t head = shm->head;
+  uint32_t frames = 0;
+
+  while (head != ebAtomicLoad(&shm->tail)) {
+    uint32_t off = head & (shm->size - 1);
+    uint32_t len = *(volatile uint32_t *)&data[off];
+    if (len == SHM_WRAP) {
+      head += shm->size - off;
+      continue;
+    }
+    if (prvReceive(bridge, &data[off + 4], len) == RX_REFUSED) {
+      break;
+    }
+    head += 4 + SHM_ALIGN(len);
+    frames++;
+  }
+  /* Frees the consumed frames for the sender in one go */
+  ebAtomicStore(&shm->head, head);
+  return frames;
+}
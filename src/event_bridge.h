@@ -0,0 +1,172 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Erik Friesen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef EVENTBRIDGE_H
+#define EVENTBRIDGE_H
+
+/*
+ * Forwards selected event IDs to another bus, typically on another MCU.
+ * The sending bridge is a ring listener that packs each batch it drains
+ * into frames; the receiving side hands frames to eventBridgeReceive,
+ * which republishes every event with its original publisherId.
+ *
+ * Frames are little endian: an 8 byte header (magic, version, record
+ * count, flags, total length, sequence) and then per event its ID,
+ * publisherId, payload length and payload. The event_t header itself is
+ * never sent, so the two sides only have to agree on payload layouts.
+ *
+ * Route each ID on one side only, an ID bridged both ways would loop.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "event_bus.h"
+
+/* Events drained from the listener ring per eventBridgeFlush */
+#ifndef EVENT_BRIDGE_BATCH
+#define EVENT_BRIDGE_BATCH 16
+#endif
+
+/*
+ * Longest eventBridgeFlush waits for the transport to take a frame. After
+ * that the rest of the batch is only tried without waiting, and events
+ * that find no room count in txDropped.
+ */
+#ifndef EVENT_BRIDGE_TX_WAIT
+#define EVENT_BRIDGE_TX_WAIT pdMS_TO_TICKS(100)
+#endif
+
+#define EVENT_BRIDGE_HDR_SZ 8
+#define EVENT_BRIDGE_REC_SZ 6
+
+typedef struct {
+  uint32_t eventId;
+  /* Whole event as passed to eventAlloc, header included */
+  uint16_t size;
+} event_bridge_route_t;
+
+/*
+ * Link to the other side. reserve hands out room for one frame of up to
+ * len bytes, or NULL once xTicksToWait runs out; commit sends the first
+ * len bytes of it. Frames are built in place, so a transport that can
+ * lend out its own buffer (DMA, shared RAM) avoids a copy.
+ */
+typedef struct {
+  uint8_t *(*reserve)(void *ctx, size_t len, TickType_t xTicksToWait);
+  void (*commit)(void *ctx, uint8_t *frame, size_t len);
+  void *ctx;
+} event_bridge_transport_t;
+
+typedef struct {
+  /* Filled in by the application, unused on a receive only bridge */
+  const event_bridge_route_t *routes;
+  uint32_t routeCount;
+  const event_bridge_transport_t *transport;
+  /* Largest frame the transport takes */
+  uint16_t mtu;
+  /*
+   * Receive flow control: a frame is refused while any pool class it
+   * needs would drop to this many free blocks or fewer.
+   */
+  uint16_t lowWater;
+  event_ring_t ring;
+  const char *name;
+  /* Owned by the bridge */
+  event_listener_t listener;
+  uint16_t txSeq;
+  uint16_t rxSeq;
+  uint32_t txFrames;
+  /* Events drained but lost to a transport that stayed full */
+  uint32_t txDropped;
+  uint32_t rxFrames;
+  /* Frames refused for flow control, the sender should retry them */
+  uint32_t rxRefused;
+  uint32_t rxErrors;
+  /* Events of accepted frames lost to a pool drained meanwhile */
+  uint32_t rxDropped;
+  /* Sequence gaps seen on receive */
+  uint32_t rxLost;
+} event_bridge_t;
+
+/*
+ * Attaches the bridge listener and subscribes the routed IDs. Set ring
+ * with EVENT_RING_INIT, it bounds how many events wait for the link.
+ */
+void eventBridgeStart(event_bridge_t *bridge);
+void eventBridgeStop(event_bridge_t *bridge);
+/*
+ * Drains up to EVENT_BRIDGE_BATCH events, waiting up to xTicksToWait for
+ * the first, packs them into as few frames as the mtu allows and commits
+ * them. Returns the number of events sent.
+ */
+size_t eventBridgeFlush(event_bridge_t *bridge, TickType_t xTicksToWait);
+/* Task body calling eventBridgeFlush forever, pvParameters is the bridge */
+void eventBridgeTask(void *pvParameters);
+/*
+ * Republishes the events of one frame. pdFAIL if it is malformed, or
+ * refused by flow control, in which case nothing was published and the
+ * same frame can be offered again later.
+ */
+BaseType_t eventBridgeReceive(event_bridge_t *bridge, const uint8_t *frame,
+                              size_t len);
+
+/*
+ * Single producer, single consumer frame ring in memory both cores can
+ * see, for AMP parts. The region must not be cached, or be cleaned and
+ * invalidated by the platform around each access. Frames are length
+ * prefixed and 4 byte aligned, size must be a power of two.
+ */
+typedef struct {
+  volatile uint32_t head;
+  volatile uint32_t tail;
+  uint32_t size;
+  uint32_t magic;
+} event_bridge_shm_t;
+
+typedef struct {
+  /* Header followed by size bytes of ring data */
+  event_bridge_shm_t *shm;
+  /* Optional, raises the other core's interrupt after a commit */
+  void (*notify)(void);
+  /* Sender side, skip before the reserved frame when it wrapped */
+  uint32_t skip;
+} event_bridge_shm_link_t;
+
+/* Run once, by one core, before either side uses the ring */
+event_bridge_shm_t *eventBridgeShmInit(void *mem, size_t bytes);
+uint8_t *eventBridgeShmReserve(void *ctx, size_t len, TickType_t xTicksToWait);
+void eventBridgeShmCommit(void *ctx, uint8_t *frame, size_t len);
+/*
+ * Receiving core, feeds every complete frame to bridge in place. Stops
+ * early at a frame flow control refused and leaves it queued, which in
+ * turn holds off the sender. Returns the frames consumed.
+ */
+uint32_t eventBridgeShmPoll(event_bridge_shm_link_t *link,
+                            event_bridge_t *bridge);
+
+#define EVENT_BRIDGE_SHM_TRANSPORT(link)                                       \
+  { .reserve = eventBridgeShmReserve, .commit = eventBridgeShmCommit,          \
+    .ctx = (link) }
+
+#endif /* EVENTBRIDGE_H */
@@ -32,30 +32,257 @@
 #include <timers.h>
 #include "event_bus.h"
 #include "event_bus_config.h"
+#include "event_bus_port.h"
 #include "mem_pool.h"
 
 static event_listener_t *firstListener = NULL;
+static event_listener_t *lastListener = NULL;
+
+typedef struct {
+  volatile uint32_t maxResponse;
+  volatile uint32_t minResponse;
+  event_listener_t *maxList;
+#if EVENT_BUS_HIST == 1
+  event_hist_t hist;
+#endif
+#if EVENT_BUS_STATS == 1
+  volatile uint32_t publishes;
+#endif
+} EVENT_STATS;
+
+/*
+ * Per-event subscriber index, only holds attached listeners and the
+ * one-shot waiter nodes waitEvent keeps on its own stack.
+ */
+typedef struct SUB_NODE_T {
+  union {
+    event_listener_t *listener;
+    TaskHandle_t task; /* When waiter is set */
+  };
+  struct SUB_NODE_T *next;
+  /* Copied from the listener's filter list, NULL delivers everything */
+  const event_filter_t *filter;
+#if EVENT_BUS_SPARSE == 1
+  /* Next subscription of the same listener */
+  struct SUB_NODE_T *lnext;
+  uint32_t eventId;
+#endif
+  uint8_t conflate;
+  uint8_t waiter;
+} sub_node_t;
+static sub_node_t subNodePool[EVENT_BUS_MAX_SUBSCRIPTIONS];
+static mp_pool_t mpSubNodes = {0};
+
+#if EVENT_BUS_SPARSE == 1
+/*
+ * One record per event ID in use, found through a small hash table.
+ * Records never leave their bucket, so lookups need no lock, and a missing
+ * record reads as no subscribers, nothing retained and the default lane.
+ * The bus frees a record once it holds none of those, and the next ID
+ * added to that bucket reuses it with fresh stats.
+ */
+typedef struct EVENT_REC_T {
+  uint32_t id;
+  sub_node_t *subs;
+  event_t *retained;
+  EVENT_STATS stats;
+  uint8_t lane;
+  struct EVENT_REC_T *volatile next;
+} event_rec_t;
+static event_rec_t eventRecs[EVENT_BUS_SPARSE_EVENTS];
+static uint32_t eventRecCount;
+static event_rec_t *volatile eventBuckets[EVENT_BUS_SPARSE_BUCKETS];
+/* No valid ID matches it, so lookups skip free records */
+#define EVENT_REC_FREE 0xFFFFFFFFu
+
+/* Called inside a critical section */
+static event_rec_t *prvEventRecAdd(uint32_t eventId) {
+  event_rec_t *volatile *bucket =
+      &eventBuckets[eventId & (EVENT_BUS_SPARSE_BUCKETS - 1)];
+  event_rec_t *rec, *spare = NULL;
+  /* Someone may have added it since the lookup */
+  for (rec = *bucket; rec != NULL; rec = rec->next) {
+    if (rec->id == eventId) {
+      return rec;
+    }
+    if (rec->id == EVENT_REC_FREE && spare == NULL) {
+      spare = rec;
+    }
+  }
+  if (spare != NULL) {
+    rec = spare;
+  } else {
+    configASSERT(eventRecCount < EVENT_BUS_SPARSE_EVENTS); /* Increase EVENT_BUS_SPARSE_EVENTS */
+    rec = &eventRecs[eventRecCount++];
+    rec->next = *bucket;
+    *bucket = rec;
+  }
+  rec->stats = (EVENT_STATS){0};
+  rec->lane = EVENT_BUS_LANES - 1;
+  rec->id = eventId;
+  return rec;
+}
+
+static event_rec_t *prvEventRec(uint32_t eventId, bool create) {
+  event_rec_t *rec;
+  UBaseType_t mask;
+  for (rec = eventBuckets[eventId & (EVENT_BUS_SPARSE_BUCKETS - 1)];
+       rec != NULL; rec = rec->next) {
+    if (rec->id == eventId) {
+      return rec;
+    }
+  }
+  if (!create) {
+    return NULL;
+  }
+  mask = taskENTER_CRITICAL_FROM_ISR();
+  rec = prvEventRecAdd(eventId);
+  taskEXIT_CRITICAL_FROM_ISR(mask);
+  return rec;
+}
+
+/* Bus task only, once the ID has no subscribers, retained event or lane */
+static void prvEventRecTrim(uint32_t eventId) {
+  event_rec_t *rec = prvEventRec(eventId, false);
+  UBaseType_t mask;
+  if (rec == NULL) {
+    return;
+  }
+  /* eventSetLane may be adding to it from another task */
+  mask = taskENTER_CRITICAL_FROM_ISR();
+  if (rec->subs == NULL && rec->retained == NULL &&
+      rec->lane == EVENT_BUS_LANES - 1) {
+    rec->id = EVENT_REC_FREE;
+  }
+  taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+
+static inline sub_node_t *prvSubscribers(uint32_t eventId) {
+  event_rec_t *rec = prvEventRec(eventId, false);
+  return rec == NULL ? NULL : rec->subs;
+}
+
+/* The unlink paths pass false, so a missing ID is not added just to scan */
+static inline sub_node_t **prvSubscribersLink(uint32_t eventId, bool create) {
+  event_rec_t *rec = prvEventRec(eventId, create);
+  return rec == NULL ? NULL : &rec->subs;
+}
+
+static inline event_t *prvRetained(uint32_t eventId) {
+  event_rec_t *rec = prvEventRec(eventId, false);
+  return rec == NULL ? NULL : rec->retained;
+}
+
+static inline void prvSetRetained(uint32_t eventId, event_t *ev) {
+  event_rec_t *rec = prvEventRec(eventId, ev != NULL);
+  if (rec != NULL) {
+    rec->retained = ev;
+    if (ev == NULL) {
+      prvEventRecTrim(eventId);
+    }
+  }
+}
+
+static inline EVENT_STATS *prvStats(uint32_t eventId) {
+  event_rec_t *rec = prvEventRec(eventId, false);
+  return rec == NULL ? NULL : &rec->stats;
+}
+
+static inline uint32_t prvEventLane(uint32_t eventId) {
+  event_rec_t *rec = prvEventRec(eventId, false);
+  return rec == NULL ? EVENT_BUS_LANES - 1 : rec->lane;
+}
+
+static inline void prvSetEventLane(uint32_t eventId, uint32_t lane) {
+  /* Set under the lock so the bus never frees the record in between */
+  UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+  prvEventRecAdd(eventId)->lane = (uint8_t)lane;
+  taskEXIT_CRITICAL_FROM_ISR(mask);
+}
+#else
 static event_t *retainedEvents[EVENT_BUS_BITS] = {0};
-static volatile uint32_t eventMaxResponse[EVENT_BUS_BITS];
-static volatile uint32_t eventMinResponse[EVENT_BUS_BITS];
-static event_listener_t *eventMaxRespList[EVENT_BUS_BITS];
+static EVENT_STATS eventStats[EVENT_BUS_BITS];
+static sub_node_t *eventSubscribers[EVENT_BUS_BITS] = {0};
+/* Lane each event ID is published on, 0 is drained first */
+static volatile uint8_t eventLane[EVENT_BUS_BITS];
+
+static inline sub_node_t *prvSubscribers(uint32_t eventId) {
+  return eventSubscribers[eventId];
+}
+
+static inline sub_node_t **prvSubscribersLink(uint32_t eventId, bool create) {
+  (void)create;
+  return &eventSubscribers[eventId];
+}
+
+static inline void prvEventRecTrim(uint32_t eventId) { (void)eventId; }
+
+static inline event_t *prvRetained(uint32_t eventId) {
+  return retainedEvents[eventId];
+}
+
+static inline void prvSetRetained(uint32_t eventId, event_t *ev) {
+  retainedEvents[eventId] = ev;
+}
+
+static inline EVENT_STATS *prvStats(uint32_t eventId) {
+  return &eventStats[eventId];
+}
+
+static inline uint32_t prvEventLane(uint32_t eventId) {
+  return eventLane[eventId];
+}
+
+static inline void prvSetEventLane(uint32_t eventId, uint32_t lane) {
+  eventLane[eventId] = (uint8_t)lane;
+}
+#endif
+
+#if EVENT_BUS_DIRECT_DISPATCH == 1
+/*
+ * Seqlock over the subscriber index, odd while the bus task is changing it.
+ * directReaders counts publishers holding a snapshot, removals wait for
+ * it to drain so a listener is never called after it has left the index.
+ */
+static volatile uint32_t indexSeq;
+static volatile uint32_t directReaders;
+/* Commands sent but not yet processed by the bus task */
+static volatile uint32_t cmdPending;
+#define INDEX_WRITE_BEGIN() (void)ebAtomicAdd(&indexSeq, 1)
+#define INDEX_WRITE_END() (void)ebAtomicAdd(&indexSeq, 1)
+#else
+#define INDEX_WRITE_BEGIN()
+#define INDEX_WRITE_END()
+#endif
 
 typedef enum {
   CMD_ATTACH,
   CMD_DETACH,
   CMD_NEW_EVENT,
+  CMD_NEW_EVENT_ASYNC,
+  CMD_NEW_EVENT_BATCH,
   CMD_INVALIDATE_EVENT,
   CMD_SUBSCRIBE_ADD,
   CMD_SUBSCRIBE_ADD_ARRAY,
-  CMD_SUBSCRIBE_REMOVE
+  CMD_SUBSCRIBE_ADD_MASK,
+  CMD_SUBSCRIBE_ADD_RANGE,
+  CMD_SUBSCRIBE_REMOVE,
+  CMD_SUBSCRIBE_REMOVE_ALL,
+  CMD_SUBSCRIBE_CONFLATE,
+  CMD_SUBSCRIBE_FILTER,
+  CMD_WAIT_ADD,
+  CMD_WAIT_REMOVE,
+  CMD_DRAIN_STAGE,
+  CMD_BARRIER
 } EVBUS_CMD_T;
 
-typedef enum {
-  DYN_ALLOC_NONE,
-  DYN_ALLOC_SMALL,
-  DYN_ALLOC_MED,
-  DYN_ALLOC_LARGE
-} DYN_ALLOC_T;
+/*
+ * 0 for static events, otherwise 1 + index into EVENT_BUS_POOL_TABLE.
+ * The top value marks an event_ext_t, its header comes from extClass.
+ */
+typedef uint8_t DYN_ALLOC_T;
+#define DYN_ALLOC_NONE 0
+#define DYN_ALLOC_EXTERNAL 0xFF
 
 typedef struct {
   EVBUS_CMD_T command;
@@ -63,8 +290,13 @@ typedef struct {
   union {
     const uint32_t *arrayParams;
     uint32_t params;
+    event_filter_t *filter;
+    event_complete_t onComplete;
   };
   void *eventData;
+#if EVENT_BUS_HIST == 1
+  uint32_t sentTime;
+#endif
 } EVENT_CMD;
 
 /* FreeRTOS Stack allocation */
@@ -72,91 +304,1335 @@ typedef struct {
 #if EVENT_BUS_DYNAMIC_FREERTOS != 1
 static StackType_t xStack[STACK_SIZE];
 static StaticTask_t xTaskBuffer;
-static StaticQueue_t xStaticQueue;
-static uint8_t ucQueueStorage[EVENT_BUS_MAX_CMD_QUEUE * sizeof(EVENT_CMD)];
-#endif
-static QueueHandle_t xQueueCmd = NULL;
-
-/* Event memory pool */
-#define POOL_SIZE_CALC(size) (size + sizeof(event_t))
-static uint8_t smEventPool[EVENT_BUS_POOL_SM_CT *
-                           POOL_SIZE_CALC(EVENT_BUS_POOL_SM_SZ)] = {0};
-static uint8_t mdEventPool[EVENT_BUS_POOL_MD_CT *
-                           POOL_SIZE_CALC(EVENT_BUS_POOL_MD_SZ)] = {0};
-static uint8_t lgEventPool[EVENT_BUS_POOL_LG_CT *
-                           POOL_SIZE_CALC(EVENT_BUS_POOL_LG_SZ)] = {0};
-static mp_pool_t mpSmall = {0};
-static mp_pool_t mpMed = {0};
-static mp_pool_t mpLarge = {0};
+#if EVENT_BUS_CMD_TRANSPORT == EVENT_BUS_TRANSPORT_QUEUE
+static StaticQueue_t xStaticQueue[EVENT_BUS_LANES];
+static uint8_t ucQueueStorage[EVENT_BUS_LANES]
+                             [EVENT_BUS_MAX_CMD_QUEUE * sizeof(EVENT_CMD)];
+#endif
+#endif
+static TaskHandle_t xBusTask = NULL;
+
+/* Commands taken from each lane, for eventBatchInfo */
+static uint32_t laneCount[EVENT_BUS_LANES];
+
+#if EVENT_BUS_STATS == 1
+static uint32_t laneHighWater[EVENT_BUS_LANES];
+static volatile uint32_t cmdSendFails;
+/* depth includes the command just taken, only evaluated with stats on */
+#define NOTE_DEPTH(lane, depth)                                                \
+  do {                                                                         \
+    uint32_t noteDepth = (depth);                                              \
+    if (noteDepth > laneHighWater[lane]) {                                     \
+      laneHighWater[lane] = noteDepth;                                         \
+    }                                                                          \
+  } while (0)
+#define COUNT_SEND_FAIL(ret)                                                   \
+  do {                                                                         \
+    if ((ret) != pdTRUE) {                                                     \
+      (void)ebAtomicAdd(&cmdSendFails, 1);                                     \
+    }                                                                          \
+  } while (0)
+#define COUNT_DELIVERED(l) (void)ebAtomicAdd(&(l)->delivered, 1)
+#define COUNT_DROPPED(l) (void)ebAtomicAdd(&(l)->dropped, 1)
+#else
+#define NOTE_DEPTH(lane, depth)
+#define COUNT_SEND_FAIL(ret)
+#define COUNT_DELIVERED(l)
+#define COUNT_DROPPED(l)
+#endif
+
+#if EVENT_BUS_TRACE == 1
+#if (EVENT_BUS_TRACE_SIZE & (EVENT_BUS_TRACE_SIZE - 1)) != 0
+#error "EVENT_BUS_TRACE_SIZE must be a power of two"
+#endif
+/* volatile keeps type the last store, 0 marks a record being written */
+static volatile event_trace_rec_t traceRing[EVENT_BUS_TRACE_SIZE];
+static volatile uint32_t traceHead;
+
+static inline void prvTrace(uint8_t type, const event_t *ev,
+                            const event_listener_t *listener) {
+  uint32_t seq = ebAtomicAdd(&traceHead, 1);
+  volatile event_trace_rec_t *rec =
+      &traceRing[seq & (EVENT_BUS_TRACE_SIZE - 1)];
+  rec->type = 0;
+  rec->time = EVENT_BUS_TRACE_TIME;
+  rec->event = (uint32_t)(uintptr_t)ev;
+  rec->listener = (uint32_t)(uintptr_t)listener;
+  rec->eventId = (uint16_t)ev->event;
+  rec->seq = (uint8_t)seq;
+  rec->type = type;
+}
+#define TRACE(type, ev, listener) prvTrace(EVENT_TRACE_##type, ev, listener)
+#else
+#define TRACE(type, ev, listener)
+#endif
+
+/* Delivery outcomes feed both the counters and the trace */
+#define NOTE_DELIVERED(l, ev)                                                  \
+  do {                                                                         \
+    COUNT_DELIVERED(l);                                                        \
+    TRACE(DELIVER, ev, l);                                                     \
+  } while (0)
+#define NOTE_DROPPED(l, ev)                                                    \
+  do {                                                                         \
+    COUNT_DROPPED(l);                                                          \
+    TRACE(DROP, ev, l);                                                        \
+  } while (0)
+
+#if EVENT_BUS_CMD_TRANSPORT == EVENT_BUS_TRANSPORT_QUEUE
+static QueueHandle_t xQueueCmd[EVENT_BUS_LANES] = {NULL};
+#else
+/*
+ * Bounded MPSC ring. Each cell carries a sequence number, a producer owns
+ * cell pos once it moves cmdTail from pos to pos + 1, and publishes it by
+ * storing pos + 1 in the cell. The bus task is the only consumer.
+ */
+typedef struct {
+  volatile uint32_t seq;
+  EVENT_CMD cmd;
+} RING_SLOT;
+#define RING_CELL_SIZE                                                         \
+  (((sizeof(RING_SLOT) + EVENT_BUS_CACHE_LINE - 1) / EVENT_BUS_CACHE_LINE) *   \
+   EVENT_BUS_CACHE_LINE)
+typedef union {
+  RING_SLOT slot;
+  uint8_t pad[RING_CELL_SIZE];
+} RING_CELL;
+typedef union {
+  volatile uint32_t pos;
+  uint8_t pad[EVENT_BUS_CACHE_LINE];
+} RING_INDEX;
+static EVENT_BUS_ALIGNED(EVENT_BUS_CACHE_LINE) RING_CELL
+    cmdRing[EVENT_BUS_LANES][EVENT_BUS_MAX_CMD_QUEUE];
+static EVENT_BUS_ALIGNED(EVENT_BUS_CACHE_LINE) RING_INDEX
+    cmdHead[EVENT_BUS_LANES];
+static EVENT_BUS_ALIGNED(EVENT_BUS_CACHE_LINE) RING_INDEX
+    cmdTail[EVENT_BUS_LANES];
+#endif
+
+/* Commands handled per wakeup, log2 buckets: 1, 2-3, 4-7 ... */
+#define BATCH_HIST_BUCKETS 8
+static uint32_t batchHistogram[BATCH_HIST_BUCKETS];
+static uint32_t batchMax;
+
+/* Event memory pools, one region per EVENT_BUS_POOL_TABLE entry. Blocks are
+   rounded up to 8 so every block of a class stays aligned for the payload */
+#define POOL_SIZE_CALC(size) ((((size) + sizeof(event_t)) + 7) & ~(size_t)7)
+#define POOL_REGION_CALC(size, count)                                          \
+  (((count)*POOL_SIZE_CALC(size) + 7) & ~(size_t)7)
+#define POOL_X_REGION(size, count) +POOL_REGION_CALC(size, count)
+#define POOL_X_SIZE(size, count) POOL_SIZE_CALC(size),
+#define POOL_X_COUNT(size, count) count,
+#define POOL_X_ONE(size, count) +1
+#if (0 EVENT_BUS_POOL_TABLE(POOL_X_ONE)) > 7
+#error EVENT_BUS_POOL_TABLE is limited to 7 classes
+#endif
+/* Index 0 is DYN_ALLOC_NONE */
+#define POOL_CLASSES (1 EVENT_BUS_POOL_TABLE(POOL_X_ONE))
+static const uint32_t poolBlockSize[POOL_CLASSES] = {
+    0, EVENT_BUS_POOL_TABLE(POOL_X_SIZE)};
+static const uint32_t poolBlockCount[POOL_CLASSES] = {
+    0, EVENT_BUS_POOL_TABLE(POOL_X_COUNT)};
+static EVENT_BUS_ALIGNED(8) uint8_t
+    eventPoolStorage[0 EVENT_BUS_POOL_TABLE(POOL_X_REGION)] = {0};
+/* Requested vs handed out bytes, for eventPoolInfo */
+static uint64_t poolAllocs[POOL_CLASSES];
+static uint64_t poolReqBytes[POOL_CLASSES];
+#if EVENT_BUS_POOL_LOCKFREE == 1
+typedef mp_lf_pool_t ev_pool_t;
+#define EV_POOL_INIT mp_lf_init
+#define EV_POOL_MALLOC mp_lf_malloc
+#define EV_POOL_FREE mp_lf_free
+#define EV_POOL_INTEGRITY mp_lf_integrity
+#define EV_POOL_LOCK()
+#define EV_POOL_UNLOCK()
+#else
+typedef mp_pool_t ev_pool_t;
+#define EV_POOL_INIT mp_init
+#define EV_POOL_MALLOC mp_malloc
+#define EV_POOL_FREE mp_free
+#define EV_POOL_INTEGRITY mp_integrity
+#define EV_POOL_LOCK() vTaskSuspendAll()
+#define EV_POOL_UNLOCK() (void)xTaskResumeAll()
+#endif
+/* Indexed by DYN_ALLOC_T */
+static ev_pool_t eventPools[POOL_CLASSES] = {0};
+/* Pool class holding event_ext_t headers */
+static DYN_ALLOC_T extClass = DYN_ALLOC_NONE;
+
+#if EVENT_BUS_POOL_CACHE_SZ > 0
+#if EVENT_BUS_POOL_LOCKFREE != 1
+#error EVENT_BUS_POOL_CACHE_SZ requires EVENT_BUS_POOL_LOCKFREE
+#endif
+/*
+ * Per-core magazine in front of each pool. Only touched by its own core
+ * with local interrupts masked, so it needs no shared lock. Misses refill
+ * and overflows flush half a magazine at a time.
+ */
+#define POOL_CACHE_BATCH ((EVENT_BUS_POOL_CACHE_SZ + 1) / 2)
+typedef struct {
+  uint32_t count;
+  uint32_t hits;
+  uint32_t misses;
+  void *blocks[EVENT_BUS_POOL_CACHE_SZ];
+} POOL_CACHE;
+static EVENT_BUS_ALIGNED(EVENT_BUS_CACHE_LINE) POOL_CACHE
+    poolCache[EVENT_BUS_NUM_CORES][POOL_CLASSES];
+#endif
+
+/*
+ * Publishes go on their event's lane, barriers on the lane in params,
+ * everything else on lane 0
+ */
+static inline uint32_t prvCmdLane(const EVENT_CMD *cmd) {
+  if (cmd->command == CMD_BARRIER) {
+    return cmd->params;
+  }
+  if (cmd->command == CMD_NEW_EVENT || cmd->command == CMD_NEW_EVENT_ASYNC) {
+    return prvEventLane(((event_t *)cmd->eventData)->event);
+  }
+  if (cmd->command == CMD_NEW_EVENT_BATCH) {
+    /* A batch runs at the priority of its most urgent event */
+    event_t *const *evs = cmd->eventData;
+    uint32_t i, l, lane = EVENT_BUS_LANES - 1;
+    for (i = 0; i < cmd->params; i++) {
+      l = prvEventLane(evs[i]->event);
+      if (l < lane) {
+        lane = l;
+      }
+    }
+    return lane;
+  }
+  return 0;
+}
+
+#if EVENT_BUS_CMD_TRANSPORT == EVENT_BUS_TRANSPORT_QUEUE
+#if EVENT_BUS_LANES == 1
+static inline BaseType_t prvTransportSend(const EVENT_CMD *cmd,
+                                          TickType_t xTicksToWait) {
+  return xQueueSendToBack(xQueueCmd[0], (void *)cmd, xTicksToWait);
+}
+
+static inline BaseType_t prvTransportSendFromISR(const EVENT_CMD *cmd,
+                                                 BaseType_t *pxWoken) {
+  return xQueueSendToBackFromISR(xQueueCmd[0], (void *)cmd, pxWoken);
+}
+
+static inline BaseType_t prvCmdReceive(EVENT_CMD *cmd,
+                                       TickType_t xTicksToWait) {
+  if (xQueueReceive(xQueueCmd[0], cmd, xTicksToWait) != pdTRUE) {
+    return pdFALSE;
+  }
+  laneCount[0]++;
+  NOTE_DEPTH(0, uxQueueMessagesWaiting(xQueueCmd[0]) + 1);
+  return pdTRUE;
+}
+#else
+/* One queue per lane, the bus task sleeps on its notification instead */
+static BaseType_t prvTransportSend(const EVENT_CMD *cmd,
+                                   TickType_t xTicksToWait) {
+  if (xQueueSendToBack(xQueueCmd[prvCmdLane(cmd)], (void *)cmd,
+                       xTicksToWait) != pdTRUE) {
+    return errQUEUE_FULL;
+  }
+  xTaskNotifyGive(xBusTask);
+  return pdTRUE;
+}
+
+static BaseType_t prvTransportSendFromISR(const EVENT_CMD *cmd,
+                                          BaseType_t *pxWoken) {
+  if (xQueueSendToBackFromISR(xQueueCmd[prvCmdLane(cmd)], (void *)cmd,
+                              pxWoken) != pdTRUE) {
+    return errQUEUE_FULL;
+  }
+  vTaskNotifyGiveFromISR(xBusTask, pxWoken);
+  return pdTRUE;
+}
+
+static BaseType_t prvCmdReceive(EVENT_CMD *cmd, TickType_t xTicksToWait) {
+  uint32_t lane;
+  for (;;) {
+    for (lane = 0; lane < EVENT_BUS_LANES; lane++) {
+      if (xQueueReceive(xQueueCmd[lane], cmd, 0) == pdTRUE) {
+        laneCount[lane]++;
+        NOTE_DEPTH(lane, uxQueueMessagesWaiting(xQueueCmd[lane]) + 1);
+        return pdTRUE;
+      }
+    }
+    if (xTicksToWait == 0) {
+      return pdFALSE;
+    }
+    (void)ulTaskNotifyTake(pdTRUE, xTicksToWait);
+  }
+}
+#endif
+#else
+static void prvRingInit(void) {
+  uint32_t i, lane;
+  for (lane = 0; lane < EVENT_BUS_LANES; lane++) {
+    for (i = 0; i < EVENT_BUS_MAX_CMD_QUEUE; i++) {
+      cmdRing[lane][i].slot.seq = i;
+    }
+    cmdHead[lane].pos = cmdTail[lane].pos = 0;
+  }
+}
+
+/* Returns pdTRUE if the bus task must be woken */
+static BaseType_t prvRingPush(const EVENT_CMD *cmd, BaseType_t *pxFull) {
+  RING_CELL *cell;
+  uint32_t lane = prvCmdLane(cmd);
+  volatile uint32_t *tail = &cmdTail[lane].pos;
+  uint32_t pos = ebAtomicLoad(tail);
+  int32_t diff;
+  for (;;) {
+    cell = &cmdRing[lane][pos & (EVENT_BUS_MAX_CMD_QUEUE - 1)];
+    diff = (int32_t)(ebAtomicLoad(&cell->slot.seq) - pos);
+    if (diff == 0) {
+      if (ebAtomicCas(tail, pos, pos + 1)) {
+        break;
+      }
+      pos = ebAtomicLoad(tail);
+    } else if (diff < 0) {
+      *pxFull = pdTRUE;
+      return pdFALSE;
+    } else {
+      pos = ebAtomicLoad(tail);
+    }
+  }
+  cell->slot.cmd = *cmd;
+  ebAtomicStore(&cell->slot.seq, pos + 1);
+  *pxFull = pdFALSE;
+  /* Consumer only sleeps with cmdHead parked on an unpublished cell */
+  return ebAtomicLoad(&cmdHead[lane].pos) == pos;
+}
+
+static BaseType_t prvRingPop(EVENT_CMD *cmd) {
+  uint32_t lane;
+  for (lane = 0; lane < EVENT_BUS_LANES; lane++) {
+    uint32_t pos = cmdHead[lane].pos;
+    RING_CELL *cell = &cmdRing[lane][pos & (EVENT_BUS_MAX_CMD_QUEUE - 1)];
+    if (ebAtomicLoad(&cell->slot.seq) != pos + 1) {
+      continue;
+    }
+    *cmd = cell->slot.cmd;
+    ebAtomicStore(&cell->slot.seq, pos + EVENT_BUS_MAX_CMD_QUEUE);
+    ebAtomicStore(&cmdHead[lane].pos, pos + 1);
+    laneCount[lane]++;
+    NOTE_DEPTH(lane, ebAtomicLoad(&cmdTail[lane].pos) - pos);
+    return pdTRUE;
+  }
+  return pdFALSE;
+}
+
+static BaseType_t prvTransportSend(const EVENT_CMD *cmd,
+                                   TickType_t xTicksToWait) {
+  BaseType_t full;
+  TickType_t start = xTaskGetTickCount();
+  for (;;) {
+    if (prvRingPush(cmd, &full)) {
+      xTaskNotifyGive(xBusTask);
+    }
+    if (!full) {
+      return pdTRUE;
+    }
+    if (xTaskGetTickCount() - start >= xTicksToWait) {
+      return errQUEUE_FULL;
+    }
+    vTaskDelay(1);
+  }
+}
+
+static BaseType_t prvTransportSendFromISR(const EVENT_CMD *cmd,
+                                          BaseType_t *pxWoken) {
+  BaseType_t full;
+  if (prvRingPush(cmd, &full)) {
+    vTaskNotifyGiveFromISR(xBusTask, pxWoken);
+  }
+  return !full;
+}
+
+static BaseType_t prvCmdReceive(EVENT_CMD *cmd, TickType_t xTicksToWait) {
+  while (!prvRingPop(cmd)) {
+    if (xTicksToWait == 0) {
+      return pdFALSE;
+    }
+    (void)ulTaskNotifyTake(pdTRUE, xTicksToWait);
+  }
+  return pdTRUE;
+}
+#endif
+
+#if EVENT_BUS_HIST == 1
+#define CMD_STAMP(cmd) ((cmd)->sentTime = EVENT_BUS_TIME_SOURCE)
+#define CMD_STAMP_FROM_ISR(cmd)                                                \
+  ((cmd)->sentTime = EVENT_BUS_TIME_SOURCE_FROM_ISR)
+#else
+#define CMD_STAMP(cmd)
+#define CMD_STAMP_FROM_ISR(cmd)
+#endif
+
+#if EVENT_BUS_DIRECT_DISPATCH == 1
+/* Counted before the send so a direct publish never overtakes it */
+static inline BaseType_t prvCmdSend(EVENT_CMD *cmd, TickType_t xTicksToWait) {
+  CMD_STAMP(cmd);
+  (void)ebAtomicAdd(&cmdPending, 1);
+  BaseType_t ret = prvTransportSend(cmd, xTicksToWait);
+  if (ret != pdTRUE) {
+    (void)ebAtomicSub(&cmdPending, 1);
+  }
+  COUNT_SEND_FAIL(ret);
+  return ret;
+}
+
+static inline BaseType_t prvCmdSendFromISR(EVENT_CMD *cmd,
+                                           BaseType_t *pxWoken) {
+  CMD_STAMP_FROM_ISR(cmd);
+  (void)ebAtomicAdd(&cmdPending, 1);
+  BaseType_t ret = prvTransportSendFromISR(cmd, pxWoken);
+  if (ret != pdTRUE) {
+    (void)ebAtomicSub(&cmdPending, 1);
+  }
+  COUNT_SEND_FAIL(ret);
+  return ret;
+}
+#else
+static inline BaseType_t prvCmdSend(EVENT_CMD *cmd, TickType_t xTicksToWait) {
+  CMD_STAMP(cmd);
+  BaseType_t ret = prvTransportSend(cmd, xTicksToWait);
+  COUNT_SEND_FAIL(ret);
+  return ret;
+}
+
+static inline BaseType_t prvCmdSendFromISR(EVENT_CMD *cmd,
+                                           BaseType_t *pxWoken) {
+  CMD_STAMP_FROM_ISR(cmd);
+  BaseType_t ret = prvTransportSendFromISR(cmd, pxWoken);
+  COUNT_SEND_FAIL(ret);
+  return ret;
+}
+#endif
+
+static void prvCmdSendWait(EVENT_CMD *cmd) {
+  cmd->xCallingTask = xTaskGetCurrentTaskHandle();
+  prvCmdSend(cmd, portMAX_DELAY);
+#ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
+  ulTaskNotifyTakeIndexed(EVENT_BUS_USE_TASK_NOTIFICATION_INDEX, pdTRUE,
+                          portMAX_DELAY);
+#else
+  taskYIELD();
+#endif
+}
+
+/*
+ * Queued without waiting for the bus. Commands share lane 0, so they run
+ * in order and ahead of any publish sent after them.
+ */
+static BaseType_t prvCmdSendDeferred(EVENT_CMD *cmd, TickType_t xTicksToWait) {
+  cmd->xCallingTask = NULL;
+  if (xTaskGetCurrentTaskHandle() == xBusTask) {
+    /* From a callback, blocking on our own queue would never return */
+    xTicksToWait = 0;
+  }
+  return prvCmdSend(cmd, xTicksToWait);
+}
+
+/* Smallest class that fits size, DYN_ALLOC_NONE if none does */
+static DYN_ALLOC_T prvPoolClass(size_t size) {
+  DYN_ALLOC_T lo = 1;
+  DYN_ALLOC_T hi = POOL_CLASSES;
+  while (lo < hi) {
+    DYN_ALLOC_T mid = (lo + hi) / 2;
+    if (poolBlockSize[mid] < size) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo < POOL_CLASSES ? lo : DYN_ALLOC_NONE;
+}
+
+#if EVENT_BUS_POOL_CACHE_SZ > 0
+static void *prvPoolMalloc(DYN_ALLOC_T cls) {
+  void *b = NULL;
+  UBaseType_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+  POOL_CACHE *cache = &poolCache[EVENT_BUS_CORE_ID()][cls];
+  if (cache->count == 0) {
+    cache->misses++;
+    while (cache->count < POOL_CACHE_BATCH) {
+      b = EV_POOL_MALLOC(&eventPools[cls]);
+      if (b == NULL) {
+        break;
+      }
+      cache->blocks[cache->count++] = b;
+    }
+  } else {
+    cache->hits++;
+  }
+  b = cache->count ? cache->blocks[--cache->count] : NULL;
+  portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+  return b;
+}
+
+static void prvPoolFree(DYN_ALLOC_T cls, void *b) {
+  UBaseType_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+  POOL_CACHE *cache = &poolCache[EVENT_BUS_CORE_ID()][cls];
+  if (cache->count == EVENT_BUS_POOL_CACHE_SZ) {
+    while (cache->count > EVENT_BUS_POOL_CACHE_SZ - POOL_CACHE_BATCH) {
+      EV_POOL_FREE(&eventPools[cls], cache->blocks[--cache->count]);
+    }
+  }
+  cache->blocks[cache->count++] = b;
+  portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+}
+#else
+static void *prvPoolMalloc(DYN_ALLOC_T cls) {
+  void *b;
+  EV_POOL_LOCK();
+  b = EV_POOL_MALLOC(&eventPools[cls]);
+  EV_POOL_UNLOCK();
+  return b;
+}
+
+static void prvPoolFree(DYN_ALLOC_T cls, void *b) {
+  EV_POOL_LOCK();
+  EV_POOL_FREE(&eventPools[cls], b);
+  EV_POOL_UNLOCK();
+}
+#endif
+
+static uint32_t prvClassFree(DYN_ALLOC_T cls) {
+  uint32_t free = poolBlockCount[cls] - eventPools[cls].count;
+#if EVENT_BUS_POOL_CACHE_SZ > 0
+  /* Only this core's cache is there for the taking, blocks cached on other
+     cores stay out of reach until they spill back to the pool */
+  free += poolCache[EVENT_BUS_CORE_ID()][cls].count;
+#endif
+  return free;
+}
+
+/* Low-water watch per class, level 0 is off */
+static volatile uint32_t poolLowLevel[POOL_CLASSES];
+static volatile uint32_t poolLowState[POOL_CLASSES];
+static event_pool_low_t poolLowCb[POOL_CLASSES];
+
+/* Runs after every alloc and free, the CAS picks one caller per crossing */
+static inline void prvPoolWatch(DYN_ALLOC_T cls) {
+  uint32_t level = ebAtomicLoad(&poolLowLevel[cls]);
+  if (level == 0) {
+    return;
+  }
+  uint32_t low = prvClassFree(cls) <= level;
+  if (ebAtomicCas(&poolLowState[cls], !low, low) && poolLowCb[cls] != NULL) {
+    poolLowCb[cls](poolBlockSize[cls], low != 0);
+  }
+}
+
+static void prvEventFree(event_t *ev) {
+  if (ev->dynamicAlloc == DYN_ALLOC_EXTERNAL) {
+    event_ext_t *ext = (event_ext_t *)ev;
+    /* Buffer goes back to its owner before the header is reused */
+    if (ext->release != NULL) {
+      ext->release(ext->data, ext->ctx);
+    }
+    prvPoolFree(extClass, ev);
+    prvPoolWatch(extClass);
+    return;
+  }
+  configASSERT(ev->dynamicAlloc != DYN_ALLOC_NONE &&
+               ev->dynamicAlloc < POOL_CLASSES);
+  DYN_ALLOC_T cls = ev->dynamicAlloc;
+  prvPoolFree(cls, ev);
+  prvPoolWatch(cls);
+}
+
+/* Drops a queued reference, without counting it as a response */
+static void prvDropRef(event_t *ev, event_listener_t *listener) {
+  if (ev->dynamicAlloc) {
+    (void)ebAtomicSub16(&listener->refCount, 1);
+    if (ebAtomicSub16(&ev->refCount, 1) == 1) {
+      prvEventFree(ev);
+    }
+  }
+}
+
+/*
+ * Listener queues are only touched by tasks, ISRs publish through the
+ * command queue, so on one core holding the scheduler keeps the rotation
+ * whole and interrupts are masked for single queue operations only. Other
+ * cores keep running with the scheduler suspended, SMP still needs the
+ * critical section.
+ */
+#if EVENT_BUS_NUM_CORES > 1
+#define CONFLATE_LOCK() taskENTER_CRITICAL()
+#define CONFLATE_UNLOCK() taskEXIT_CRITICAL()
+#else
+#define CONFLATE_LOCK() vTaskSuspendAll()
+#define CONFLATE_UNLOCK() (void)xTaskResumeAll()
+#endif
+
+/*
+ * Swaps a pending event with the same ID for eventParams by rotating the
+ * listener queue once. Returns the superseded event, or NULL if none was
+ * queued.
+ */
+static event_t *prvConflate(event_listener_t *listener, event_t *eventParams) {
+  event_t *old = NULL;
+  event_t *item;
+  UBaseType_t n;
+  if (uxQueueMessagesWaiting(listener->queueHandle) == 0) {
+    return NULL;
+  }
+  CONFLATE_LOCK();
+  n = uxQueueMessagesWaitingFromISR(listener->queueHandle);
+  while (n-- > 0 &&
+         xQueueReceiveFromISR(listener->queueHandle, &item, NULL) == pdTRUE) {
+    if (old == NULL && item->event == eventParams->event) {
+      old = item;
+      item = eventParams;
+    }
+    (void)xQueueSendToBackFromISR(listener->queueHandle, &item, NULL);
+  }
+  CONFLATE_UNLOCK();
+  return old;
+}
+
+/*
+ * Producers may be the bus task or direct publishers, so the claim is a
+ * short critical section. The owning task is the only reader.
+ */
+static BaseType_t prvListenerRingPush(event_ring_t *ring, event_t *ev) {
+  TaskHandle_t waiting;
+  UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+  uint32_t tail = ring->tail;
+  if (tail - ebAtomicLoad(&ring->head) >= ring->size) {
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+    return pdFALSE;
+  }
+  ring->slots[tail & (ring->size - 1)] = ev;
+  ebAtomicStore(&ring->tail, tail + 1);
+  waiting = ebAtomicLoadPtr((void *volatile *)&ring->waiting);
+  taskEXIT_CRITICAL_FROM_ISR(mask);
+  if (waiting != NULL) {
+    xTaskNotifyGiveIndexed(waiting, EVENT_BUS_RING_NOTIFY_INDEX);
+  }
+  return pdTRUE;
+}
+
+/* Task context only, which the bus task and direct publishers are */
+static BaseType_t prvPushWait(event_listener_t *listener, event_t *ev) {
+  TickType_t start = xTaskGetTickCount();
+  if (listener->ring == NULL) {
+    return xQueueSendToBack(listener->queueHandle, (void *)&ev,
+                            listener->overflowWait);
+  }
+  /* The ring has no producer wait list, poll it each tick instead */
+  while (xTaskGetTickCount() - start < listener->overflowWait) {
+    vTaskDelay(1);
+    if (prvListenerRingPush(listener->ring, ev) == pdTRUE) {
+      return pdTRUE;
+    }
+  }
+  return pdFALSE;
+}
+
+/*
+ * Applies the listener's overflow policy after a failed push, with ev
+ * already referenced for the listener. pdTRUE if ev ended up queued.
+ */
+static BaseType_t prvOverflow(event_listener_t *listener, event_t *ev) {
+  event_t *old = NULL;
+  switch (listener->overflow) {
+  case EVENT_OVERFLOW_DROP_OLDEST:
+    taskENTER_CRITICAL();
+    if (xQueueReceiveFromISR(listener->queueHandle, &old, NULL) == pdTRUE) {
+      (void)xQueueSendToBackFromISR(listener->queueHandle, (void *)&ev, NULL);
+    }
+    taskEXIT_CRITICAL();
+    break;
+  case EVENT_OVERFLOW_CONFLATE:
+    old = prvConflate(listener, ev);
+    break;
+  case EVENT_OVERFLOW_BLOCK:
+    return prvPushWait(listener, ev);
+  default:
+    break;
+  }
+  if (old == NULL) {
+    return pdFALSE;
+  }
+  NOTE_DROPPED(listener, old);
+  prvDropRef(old, listener);
+  return pdTRUE;
+}
+
+#if EVENT_BUS_WORKERS > 0
+/* A NULL listener is a flush marker, the worker then wakes task instead */
+typedef struct {
+  event_listener_t *listener;
+  union {
+    event_t *ev;
+    TaskHandle_t task;
+  };
+} WORK_ITEM;
+static QueueHandle_t workerQueue[EVENT_BUS_WORKERS];
+static TaskHandle_t workerTask[EVENT_BUS_WORKERS];
+#if EVENT_BUS_DYNAMIC_FREERTOS != 1
+static StackType_t workerStack[EVENT_BUS_WORKERS][EVENT_BUS_WORKER_STACK];
+static StaticTask_t workerTaskBuffer[EVENT_BUS_WORKERS];
+static StaticQueue_t workerStaticQueue[EVENT_BUS_WORKERS];
+static uint8_t workerQueueStorage[EVENT_BUS_WORKERS]
+                                 [EVENT_BUS_WORKER_QUEUE * sizeof(WORK_ITEM)];
+#endif
+
+static void prvWorkerTask(void *pvParameters) {
+  QueueHandle_t queue = pvParameters;
+  WORK_ITEM item;
+  for (;;) {
+    if (xQueueReceive(queue, &item, portMAX_DELAY) != pdTRUE) {
+      continue;
+    }
+    if (item.listener == NULL) {
+#ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
+      xTaskNotifyGiveIndexed(item.task, EVENT_BUS_USE_TASK_NOTIFICATION_INDEX);
+#else
+      xTaskNotifyGive(item.task);
+#endif
+      continue;
+    }
+    item.listener->callback(item.ev);
+    eventRelease(item.ev, item.listener);
+  }
+}
+
+/* Queue order means everything ahead of the marker has run */
+static void prvWorkerFlush(uint32_t worker) {
+  WORK_ITEM item = {.listener = NULL};
+  configASSERT(xTaskGetCurrentTaskHandle() != workerTask[worker]);
+  item.task = xTaskGetCurrentTaskHandle();
+  (void)xQueueSendToBack(workerQueue[worker], &item, portMAX_DELAY);
+#ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
+  ulTaskNotifyTakeIndexed(EVENT_BUS_USE_TASK_NOTIFICATION_INDEX, pdTRUE,
+                          portMAX_DELAY);
+#else
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+#endif
+}
+
+static void prvWorkersInit(void) {
+  configASSERT(EVENT_BUS_WORKER_PRIORITY < EVENT_BUS_RTOS_PRIORITY);
+  for (uint32_t i = 0; i < EVENT_BUS_WORKERS; i++) {
+#if EVENT_BUS_DYNAMIC_FREERTOS == 1
+    workerQueue[i] = xQueueCreate(EVENT_BUS_WORKER_QUEUE, sizeof(WORK_ITEM));
+    (void)xTaskCreate(prvWorkerTask, "Event-Worker", EVENT_BUS_WORKER_STACK,
+                      workerQueue[i], EVENT_BUS_WORKER_PRIORITY,
+                      &workerTask[i]);
+#else
+    workerQueue[i] =
+        xQueueCreateStatic(EVENT_BUS_WORKER_QUEUE, sizeof(WORK_ITEM),
+                           workerQueueStorage[i], &workerStaticQueue[i]);
+    workerTask[i] = xTaskCreateStatic(
+        prvWorkerTask, "Event-Worker", EVENT_BUS_WORKER_STACK, workerQueue[i],
+        EVENT_BUS_WORKER_PRIORITY, workerStack[i], &workerTaskBuffer[i]);
+#endif
+#if defined(configUSE_CORE_AFFINITY) && (configUSE_CORE_AFFINITY == 1) &&     \
+    EVENT_BUS_NUM_CORES > 1
+    vTaskCoreAffinitySet(workerTask[i], EVENT_BUS_WORKER_AFFINITY(i));
+#endif
+  }
+}
+#endif
+
+/* ev did not fit and its listener reference is already gone */
+static inline void prvReportFull(event_listener_t *listener, event_t *ev) {
+  (void)ev; /* Only traced */
+  listener->errFull = 1;
+  NOTE_DROPPED(listener, ev);
+  if (listener->overflow == EVENT_OVERFLOW_REPORT) {
+    EVENT_BUS_DEBUG_QUEUE_FULL(listener->name);
+  }
+}
 
+#if EVENT_BUS_WORKERS > 0
+/* The worker holds a reference until the callback returns, so only pool
+   events can be deferred */
+static void prvDeferCallback(event_listener_t *listener, event_t *ev) {
+  QueueHandle_t queue = workerQueue[listener->worker - 1];
+  WORK_ITEM item = {.listener = listener, .ev = ev};
+  configASSERT(ev->dynamicAlloc);
+  (void)ebAtomicAdd16(&ev->refCount, 1);
+  (void)ebAtomicAdd16(&listener->refCount, 1);
+  TRACE(DELIVER, ev, listener);
+  if (xQueueSendToBack(queue, &item, 0) != pdTRUE &&
+      (listener->overflow != EVENT_OVERFLOW_BLOCK ||
+       xQueueSendToBack(queue, &item, listener->overflowWait) != pdTRUE)) {
+    (void)ebAtomicSub16(&ev->refCount, 1);
+    (void)ebAtomicSub16(&listener->refCount, 1);
+    prvReportFull(listener, ev);
+  } else {
+    COUNT_DELIVERED(listener);
+  }
+}
+#endif
+
+/*
+ * Task context only, the bus task or a direct publisher. Sends use the
+ * task API so a higher priority receiver runs at once, not on the next
+ * tick.
+ */
 static inline void prvSendEvent(event_listener_t *listener,
-                                event_t *eventParams) {
+                                event_t *eventParams, bool conflate) {
   if (listener->callback != NULL) {
+#if EVENT_BUS_WORKERS > 0
+    /* A static event may be reused once publish returns, run it inline */
+    if (listener->worker != 0 && eventParams->dynamicAlloc) {
+      prvDeferCallback(listener, eventParams);
+      return;
+    }
+#endif
+    NOTE_DELIVERED(listener, eventParams);
     listener->callback(eventParams);
+  } else if (listener->ring != NULL) {
+    if (eventParams->dynamicAlloc) {
+      (void)ebAtomicAdd16(&eventParams->refCount, 1);
+      (void)ebAtomicAdd16(&listener->refCount, 1);
+    }
+    /* Traced first, the receiver may release before the push returns */
+    TRACE(DELIVER, eventParams, listener);
+    if (prvListenerRingPush(listener->ring, eventParams) != pdTRUE &&
+        prvOverflow(listener, eventParams) != pdTRUE) {
+      if (eventParams->dynamicAlloc) {
+        (void)ebAtomicSub16(&eventParams->refCount, 1);
+        (void)ebAtomicSub16(&listener->refCount, 1);
+      }
+      prvReportFull(listener, eventParams);
+    } else {
+      COUNT_DELIVERED(listener);
+    }
+  } else if (listener->queueHandle != NULL && conflate) {
+    if (eventParams->dynamicAlloc) {
+      (void)ebAtomicAdd16(&eventParams->refCount, 1);
+      (void)ebAtomicAdd16(&listener->refCount, 1);
+    }
+    TRACE(DELIVER, eventParams, listener);
+    event_t *old = prvConflate(listener, eventParams);
+    if (old != NULL) {
+      TRACE(RELEASE, old, listener);
+      prvDropRef(old, listener);
+      COUNT_DELIVERED(listener);
+    } else if (xQueueSendToBack(listener->queueHandle, (void *)&eventParams,
+                                0) != pdTRUE &&
+               prvOverflow(listener, eventParams) != pdTRUE) {
+      /* Full of other IDs, nothing to replace */
+      prvDropRef(eventParams, listener);
+      prvReportFull(listener, eventParams);
+    } else {
+      COUNT_DELIVERED(listener);
+    }
   } else if (listener->queueHandle != NULL) {
-    if (xQueueSendToBackFromISR(listener->queueHandle, (void *)&eventParams,
-                                NULL) != pdTRUE) {
-      listener->errFull = 1;
-      EVENT_BUS_DEBUG_QUEUE_FULL(listener->name);
-    } else if (eventParams->dynamicAlloc) {
-      vTaskSuspendAll();
-      eventParams->refCount++;
-      listener->refCount++;
-      xTaskResumeAll();
+    /* Reference goes first, the receiver may release before we return */
+    if (eventParams->dynamicAlloc) {
+      (void)ebAtomicAdd16(&eventParams->refCount, 1);
+      (void)ebAtomicAdd16(&listener->refCount, 1);
+    }
+    TRACE(DELIVER, eventParams, listener);
+    if (xQueueSendToBack(listener->queueHandle, (void *)&eventParams, 0) !=
+            pdTRUE &&
+        prvOverflow(listener, eventParams) != pdTRUE) {
+      if (eventParams->dynamicAlloc) {
+        /* Dispatch reference keeps this from reaching zero */
+        (void)ebAtomicSub16(&eventParams->refCount, 1);
+        (void)ebAtomicSub16(&listener->refCount, 1);
+      }
+      prvReportFull(listener, eventParams);
+    } else {
+      COUNT_DELIVERED(listener);
     }
   } else if (listener->waitingTask != NULL) {
+    NOTE_DELIVERED(listener, eventParams);
     xTaskNotifyGive(listener->waitingTask);
   }
 }
 
-static void prvPublishEvent(event_t *eventParams, bool retain) {
+static inline bool prvIsAttached(event_listener_t *listener) {
+  return listener == firstListener || listener->prev != NULL;
+}
+
+static void prvIndexLink(sub_node_t *node, uint32_t eventId) {
+  sub_node_t **tail = prvSubscribersLink(eventId, true);
+  node->next = NULL;
+  /* Append so dispatch order follows subscription order */
+  while (*tail != NULL) {
+    tail = &(*tail)->next;
+  }
+  INDEX_WRITE_BEGIN();
+  *tail = node;
+  INDEX_WRITE_END();
+}
+
+static sub_node_t *prvIndexUnlink(event_listener_t *listener,
+                                  uint32_t eventId) {
+  sub_node_t **link = prvSubscribersLink(eventId, false);
+  while (link != NULL && *link != NULL) {
+    if ((*link)->listener == listener) {
+      sub_node_t *node = *link;
+      INDEX_WRITE_BEGIN();
+      *link = node->next;
+      INDEX_WRITE_END();
+      prvEventRecTrim(eventId);
+      return node;
+    }
+    link = &(*link)->next;
+  }
+  return NULL;
+}
+
+static bool prvIndexUnlinkNode(sub_node_t *node, uint32_t eventId) {
+  sub_node_t **link = prvSubscribersLink(eventId, false);
+  while (link != NULL && *link != NULL) {
+    if (*link == node) {
+      INDEX_WRITE_BEGIN();
+      *link = node->next;
+      INDEX_WRITE_END();
+      prvEventRecTrim(eventId);
+      return true;
+    }
+    link = &(*link)->next;
+  }
+  return false;
+}
+
+static event_filter_t *prvFindFilter(event_listener_t *listener,
+                                     uint32_t eventId) {
+  event_filter_t *filter;
+  for (filter = listener->filters; filter != NULL; filter = filter->next) {
+    if (filter->eventId == eventId) {
+      return filter;
+    }
+  }
+  return NULL;
+}
+
+static void prvUnlinkFilter(event_listener_t *listener, uint32_t eventId) {
+  event_filter_t **link = &listener->filters;
+  while (*link != NULL) {
+    if ((*link)->eventId == eventId) {
+      *link = (*link)->next;
+      return;
+    }
+    link = &(*link)->next;
+  }
+}
+
+static bool prvFilterPass(const event_filter_t *filter, const event_t *ev) {
+  const uint8_t *field;
+  uint32_t v, ref, shift;
+  if (filter == NULL) {
+    return true;
+  }
+  if (filter->match != NULL) {
+    return filter->match(ev, filter->ctx);
+  }
+  field = (const uint8_t *)ev + filter->offset;
+  if (filter->width == 1) {
+    v = *field;
+  } else if (filter->width == 2) {
+    v = *(const uint16_t *)field;
+  } else {
+    v = *(const uint32_t *)field;
+  }
+  v &= filter->mask;
+  ref = filter->value;
+  if (filter->op & EVENT_FILTER_SIGNED) {
+    /* Sign extend from the field width, then order as signed */
+    shift = 32 - 8 * filter->width;
+    v = (uint32_t)((int32_t)(v << shift) >> shift) ^ 0x80000000UL;
+    ref ^= 0x80000000UL;
+  }
+  switch (filter->op & ~EVENT_FILTER_SIGNED) {
+  case EVENT_FILTER_EQ:
+    return v == ref;
+  case EVENT_FILTER_NE:
+    return v != ref;
+  case EVENT_FILTER_GT:
+    return v > ref;
+  case EVENT_FILTER_GE:
+    return v >= ref;
+  case EVENT_FILTER_LT:
+    return v < ref;
+  default:
+    return v <= ref;
+  }
+}
+
+#if EVENT_BUS_SPARSE == 1
+/*
+ * Each listener owns a chain of nodes, one per subscription. A node is
+ * also linked into its event's list while the listener is attached.
+ */
+static sub_node_t *prvFindSub(event_listener_t *listener, uint32_t eventId) {
+  sub_node_t *node;
+  for (node = listener->subs; node != NULL; node = node->lnext) {
+    if (node->eventId == eventId) {
+      return node;
+    }
+  }
+  return NULL;
+}
+
+static inline bool prvIsSubscribed(event_listener_t *listener,
+                                   uint32_t eventId) {
+  return prvFindSub(listener, eventId) != NULL;
+}
+
+static inline bool prvIsConflated(event_listener_t *listener,
+                                  uint32_t eventId) {
+  sub_node_t *node = prvFindSub(listener, eventId);
+  return node != NULL && node->conflate;
+}
+
+static void prvMarkSub(event_listener_t *listener, uint32_t eventId,
+                       bool conflate) {
+  sub_node_t *node = prvFindSub(listener, eventId);
+  if (node != NULL) {
+    node->conflate |= conflate;
+    return;
+  }
+  node = mp_malloc(&mpSubNodes);
+  configASSERT(node); /* Increase EVENT_BUS_MAX_SUBSCRIPTIONS */
+  node->listener = listener;
+  node->eventId = eventId;
+  node->conflate = conflate;
+  node->filter = prvFindFilter(listener, eventId);
+  node->lnext = listener->subs;
+  listener->subs = node;
+  if (prvIsAttached(listener)) {
+    prvIndexLink(node, eventId);
+  }
+}
+
+/* Returns true if a live index entry was removed */
+static bool prvClearSub(event_listener_t *listener, uint32_t eventId) {
+  sub_node_t **link = &listener->subs;
+  bool attached = prvIsAttached(listener);
+  while (*link != NULL) {
+    if ((*link)->eventId == eventId) {
+      sub_node_t *node = *link;
+      if (attached) {
+        (void)prvIndexUnlink(listener, eventId);
+      }
+      *link = node->lnext;
+      mp_free(&mpSubNodes, node);
+      return attached;
+    }
+    link = &(*link)->lnext;
+  }
+  return false;
+}
+
+static void prvIndexListener(event_listener_t *listener) {
+  sub_node_t *node;
+  for (node = listener->subs; node != NULL; node = node->lnext) {
+    prvIndexLink(node, node->eventId);
+  }
+}
+
+/* Subscription chain is kept, only the index entries go */
+static void prvUnindexListener(event_listener_t *listener) {
+  sub_node_t *node;
+  for (node = listener->subs; node != NULL; node = node->lnext) {
+    (void)prvIndexUnlink(listener, node->eventId);
+  }
+}
+#else
+static inline bool prvIsSubscribed(event_listener_t *listener,
+                                   uint32_t eventId) {
+  return (listener->eventMask[eventId / 32] & (1UL << (eventId % 32))) != 0;
+}
+
+static inline bool prvIsConflated(event_listener_t *listener,
+                                  uint32_t eventId) {
+  return (listener->conflateMask[eventId / 32] & (1UL << (eventId % 32))) != 0;
+}
+
+static void prvIndexAdd(event_listener_t *listener, uint32_t eventId) {
+  sub_node_t *node = mp_malloc(&mpSubNodes);
+  configASSERT(node); /* Increase EVENT_BUS_MAX_SUBSCRIPTIONS */
+  node->listener = listener;
+  node->conflate = prvIsConflated(listener, eventId);
+  node->filter = prvFindFilter(listener, eventId);
+  prvIndexLink(node, eventId);
+}
+
+static void prvMarkSub(event_listener_t *listener, uint32_t eventId,
+                       bool conflate) {
+  sub_node_t *node;
+  if (conflate) {
+    listener->conflateMask[eventId / 32] |= (1UL << (eventId % 32));
+  }
+  if (!prvIsSubscribed(listener, eventId)) {
+    listener->eventMask[eventId / 32] |= (1UL << (eventId % 32));
+    if (prvIsAttached(listener)) {
+      prvIndexAdd(listener, eventId);
+    }
+  } else if (conflate && prvIsAttached(listener)) {
+    for (node = prvSubscribers(eventId); node != NULL; node = node->next) {
+      if (node->listener == listener) {
+        node->conflate = 1;
+      }
+    }
+  }
+}
+
+/* Returns true if a live index entry was removed */
+static bool prvClearSub(event_listener_t *listener, uint32_t eventId) {
+  listener->conflateMask[eventId / 32] &= ~(1UL << (eventId % 32));
+  if (!prvIsSubscribed(listener, eventId)) {
+    return false;
+  }
+  listener->eventMask[eventId / 32] &= ~(1UL << (eventId % 32));
+  if (prvIsAttached(listener)) {
+    mp_free(&mpSubNodes, prvIndexUnlink(listener, eventId));
+    return true;
+  }
+  return false;
+}
+
+static void prvIndexListener(event_listener_t *listener) {
+  uint32_t i;
+  for (i = 0; i < EVENT_BUS_BITS; i++) {
+    if (prvIsSubscribed(listener, i)) {
+      prvIndexAdd(listener, i);
+    }
+  }
+}
+
+/* Subscription mask is kept, only the index entries go */
+static void prvUnindexListener(event_listener_t *listener) {
+  uint32_t i;
+  for (i = 0; i < EVENT_BUS_BITS; i++) {
+    if (prvIsSubscribed(listener, i)) {
+      mp_free(&mpSubNodes, prvIndexUnlink(listener, i));
+    }
+  }
+}
+#endif
+
+#if EVENT_BUS_HIST == 1
+static inline void prvHistAdd(volatile uint32_t *hist, uint32_t delta) {
+  uint32_t bucket = delta == 0 ? 0 : 32 - EVENT_BUS_CLZ(delta);
+  if (bucket >= EVENT_BUS_HIST_BUCKETS) {
+    bucket = EVENT_BUS_HIST_BUCKETS - 1;
+  }
+  (void)ebAtomicAdd(&hist[bucket], 1);
+}
+
+/* phase names the event_hist_t member, IDs without stats are skipped */
+#define RECORD_PHASE(id, phase, delta)                                         \
+  do {                                                                         \
+    EVENT_STATS *phaseStats = prvStats(id);                                    \
+    if (phaseStats != NULL) {                                                  \
+      prvHistAdd(phaseStats->hist.phase, (delta));                             \
+    }                                                                          \
+  } while (0)
+#else
+#define RECORD_PHASE(id, phase, delta)
+#endif
+
+#if EVENT_BUS_PUBLISH_TIME == 1
+#define STAMP_PUBLISH(ev) ((ev)->publishTime = EVENT_BUS_TIME_SOURCE)
+#else
+#define STAMP_PUBLISH(ev)
+#endif
+
+#if EVENT_BUS_STATS == 1
+static inline void prvCountPublish(uint32_t eventId) {
+  EVENT_STATS *stats = prvStats(eventId);
+  if (stats != NULL) {
+    (void)ebAtomicAdd(&stats->publishes, 1);
+  }
+}
+#define COUNT_PUBLISH(id) prvCountPublish(id)
+#else
+#define COUNT_PUBLISH(id)
+#endif
+
+/* Times each delivery when the listener asked for its own histograms */
+static inline void prvDeliver(event_listener_t *listener, event_t *eventParams,
+                              bool conflate) {
+#if EVENT_BUS_HIST == 1
+  if (listener->hist != NULL) {
+    uint32_t start = EVENT_BUS_TIME_SOURCE;
+    prvSendEvent(listener, eventParams, conflate);
+    prvHistAdd(listener->hist->dispatch, EVENT_BUS_TIME_SOURCE - start);
+    return;
+  }
+#endif
+  prvSendEvent(listener, eventParams, conflate);
+}
+
+/* Bus holds its own reference for the duration of the dispatch */
+static inline void prvDispatchHold(event_t *eventParams) {
+  if (eventParams->dynamicAlloc) {
+    (void)ebAtomicAdd16(&eventParams->refCount, 1);
+  }
+}
+
+/* If no subscribers kept it, make sure event is freed */
+static inline void prvDispatchDrop(event_t *eventParams) {
+  if (eventParams->dynamicAlloc &&
+      ebAtomicSub16(&eventParams->refCount, 1) == 1) {
+    prvEventFree(eventParams);
+  }
+}
+
+#if EVENT_BUS_DIRECT_DISPATCH == 1
+/* Wait out publishers that may still hold a removed listener */
+static void prvDirectQuiesce(void) {
+  while (ebAtomicLoad(&directReaders) != 0) {
+    vTaskDelay(1);
+  }
+}
+#endif
+
+/* One-shot, the waiter's stack is gone as soon as it runs again */
+static void prvWakeWaiter(sub_node_t *node, uint32_t eventId) {
+  TaskHandle_t task = node->task;
+  (void)prvIndexUnlinkNode(node, eventId);
+#if EVENT_BUS_DIRECT_DISPATCH == 1
+  prvDirectQuiesce();
+#endif
+  xTaskNotifyGive(task);
+}
+
+/*
+ * The retained slot holds its own reference on dynamic events, dropped
+ * when it is replaced, cleared by a plain publish or invalidated.
+ */
+static void prvRetainEvent(uint32_t eventId, event_t *ev) {
+  event_t *old = prvRetained(eventId);
+  if (old == ev) {
+    return;
+  }
+  if (ev != NULL) {
+    prvDispatchHold(ev);
+  }
+  prvSetRetained(eventId, ev);
+  if (old != NULL) {
+    prvDispatchDrop(old);
+  }
+}
+
+static void prvPublishEvent(event_t *eventParams, bool retain,
+                            event_complete_t onComplete) {
   configASSERT(eventParams);
   configASSERT(eventParams->event < EVENT_BUS_BITS);
   EVENT_BUS_DEBUG_PUB_EVENT(eventParams->event);
-  eventParams->publishTime = EVENT_BUS_TIME_SOURCE;
+  STAMP_PUBLISH(eventParams);
   eventParams->published = 1;
-  if (retain) {
-    retainedEvents[eventParams->event] = eventParams;
-  } else {
-    retainedEvents[eventParams->event] = NULL;
+  COUNT_PUBLISH(eventParams->event);
+  TRACE(PUBLISH, eventParams, NULL);
+  prvRetainEvent(eventParams->event, retain ? eventParams : NULL);
+  prvDispatchHold(eventParams);
+  sub_node_t *node = prvSubscribers(eventParams->event);
+  sub_node_t *next;
+  while (node != NULL) {
+    next = node->next;
+    if (node->waiter) {
+      prvWakeWaiter(node, eventParams->event);
+    } else if (prvFilterPass(node->filter, eventParams)) {
+      prvDeliver(node->listener, eventParams, node->conflate);
+    }
+    node = next;
   }
-  event_listener_t *ev = firstListener;
-  while (ev != NULL) {
-    if ((ev->eventMask[eventParams->event / 32] &
-         (1UL << (eventParams->event % 32)))) {
-      prvSendEvent(ev, eventParams);
+  RECORD_PHASE(eventParams->event, dispatch,
+               EVENT_BUS_TIME_SOURCE - eventParams->publishTime);
+  if (onComplete != NULL) {
+    onComplete(eventParams);
+  }
+  prvDispatchDrop(eventParams);
+}
+
+#if EVENT_BUS_DIRECT_DISPATCH == 1
+/*
+ * Runs the dispatch in the publishing task from a snapshot of the index.
+ * Returns false, with nothing delivered, when the bus task has to do it.
+ */
+static bool prvPublishDirect(event_t *eventParams) {
+  event_listener_t *snap[EVENT_BUS_DIRECT_MAX_SUBS];
+  uint8_t snapConflate[EVENT_BUS_DIRECT_MAX_SUBS];
+  const event_filter_t *snapFilter[EVENT_BUS_DIRECT_MAX_SUBS];
+  uint32_t count, seq, i;
+  sub_node_t *node;
+  /*
+   * Keep order with anything already queued, and clearing a retained
+   * event is a mutation, so leave both to the bus.
+   */
+  if (ebAtomicLoad(&cmdPending) != 0 ||
+      prvRetained(eventParams->event) != NULL) {
+    return false;
+  }
+  (void)ebAtomicAdd(&directReaders, 1);
+  /*
+   * One attempt only: a publisher above the bus task would never let an
+   * interrupted index write finish, so a busy index goes to the bus.
+   */
+  seq = ebAtomicLoad(&indexSeq);
+  count = 0;
+  node = NULL;
+  if ((seq & 1) == 0) {
+    node = prvSubscribers(eventParams->event);
+    while (node != NULL && count < EVENT_BUS_DIRECT_MAX_SUBS) {
+      if (node->waiter) {
+        /* Only the bus may take a waiter out of the index */
+        break;
+      }
+      snapConflate[count] = node->conflate;
+      snapFilter[count] = node->filter;
+      snap[count++] = node->listener;
+      node = node->next;
     }
-    ev = ev->next;
   }
-  /* If no subscribers, make sure event is freed */
-  if (eventParams->dynamicAlloc && eventParams->refCount == 0) {
-    vTaskSuspendAll();
-    switch (eventParams->dynamicAlloc) {
-    case DYN_ALLOC_SMALL:
-      mp_free(&mpSmall, eventParams);
-      break;
-    case DYN_ALLOC_MED:
-      mp_free(&mpMed, eventParams);
-      break;
-    case DYN_ALLOC_LARGE:
-      mp_free(&mpLarge, eventParams);
-      break;
-    default:
-      break;
+  if ((seq & 1) != 0 || node != NULL || ebAtomicLoad(&indexSeq) != seq) {
+    /* Index changing, more subscribers than the snapshot holds, or a
+       waiter */
+    (void)ebAtomicSub(&directReaders, 1);
+    return false;
+  }
+  EVENT_BUS_DEBUG_PUB_EVENT(eventParams->event);
+  STAMP_PUBLISH(eventParams);
+  eventParams->published = 1;
+  COUNT_PUBLISH(eventParams->event);
+  TRACE(PUBLISH, eventParams, NULL);
+  prvDispatchHold(eventParams);
+  for (i = 0; i < count; i++) {
+    if (prvFilterPass(snapFilter[i], eventParams)) {
+      prvDeliver(snap[i], eventParams, snapConflate[i]);
     }
-    xTaskResumeAll();
   }
+  RECORD_PHASE(eventParams->event, dispatch,
+               EVENT_BUS_TIME_SOURCE - eventParams->publishTime);
+  (void)ebAtomicSub(&directReaders, 1);
+  prvDispatchDrop(eventParams);
+  return true;
 }
+#endif
 
-static void prvSubscribeAdd(event_listener_t *listener, uint32_t newEvent) {
+static void prvSubscribe(event_listener_t *listener, uint32_t newEvent,
+                         bool conflate) {
+  event_t *retained;
   configASSERT(newEvent < EVENT_BUS_BITS); /* Probably missing EVENT_BUS_LAST_PARAM */
-  listener->eventMask[newEvent / 32] |= (1UL << (newEvent % 32));
+  prvMarkSub(listener, newEvent, conflate);
   /* Search for any retained events */
-  if (retainedEvents[newEvent]) {
-    prvSendEvent(listener, retainedEvents[newEvent]);
+  retained = prvRetained(newEvent);
+  if (retained && prvFilterPass(prvFindFilter(listener, newEvent), retained)) {
+    prvSendEvent(listener, retained, prvIsConflated(listener, newEvent));
   }
 }
 
+static void prvSubscribeAdd(event_listener_t *listener, uint32_t newEvent) {
+  prvSubscribe(listener, newEvent, false);
+}
+
 static void prvSubscribeAddArray(event_listener_t *listener,
                                  const uint32_t *eventList) {
   while (*eventList != EVENT_BUS_LAST_PARAM) {
@@ -165,96 +1641,308 @@ static void prvSubscribeAddArray(event_listener_t *listener,
   }
 }
 
+static void prvSubscribeAddRange(event_listener_t *listener,
+                                 const uint32_t *range) {
+  uint32_t i;
+  for (i = range[0]; i <= range[1]; i++) {
+    prvSubscribeAdd(listener, i);
+  }
+}
+
+#if EVENT_BUS_SPARSE != 1
+static void prvSubscribeAddMask(event_listener_t *listener,
+                                const uint32_t *mask) {
+  uint32_t w, bits;
+  for (w = 0; w < EVENT_BUS_MASK_WIDTH; w++) {
+    bits = mask[w];
+    while (bits != 0) {
+      prvSubscribeAdd(listener, w * 32 + EVENT_BUS_CTZ(bits));
+      bits &= bits - 1;
+    }
+  }
+}
+#endif
+
+static void prvSubscribeConflate(event_listener_t *listener,
+                                 uint32_t newEvent) {
+  prvSubscribe(listener, newEvent, true);
+}
+
+/*
+ * Links the filter before the subscription exists, so a new index node
+ * picks it up, then points any existing node at it.
+ */
+static void prvSubscribeFilter(event_listener_t *listener,
+                               event_filter_t *filter) {
+  uint32_t eventId = filter->eventId;
+  sub_node_t *node;
+  bool replaced = prvFindFilter(listener, eventId) != NULL;
+  configASSERT(eventId < EVENT_BUS_BITS);
+  prvUnlinkFilter(listener, eventId);
+  filter->next = listener->filters;
+  listener->filters = filter;
+  if (prvIsAttached(listener)) {
+    INDEX_WRITE_BEGIN();
+    for (node = prvSubscribers(eventId); node != NULL; node = node->next) {
+      if (!node->waiter && node->listener == listener) {
+        node->filter = filter;
+      }
+    }
+    INDEX_WRITE_END();
+  }
+#if EVENT_BUS_SPARSE == 1
+  node = prvFindSub(listener, eventId);
+  if (node != NULL) {
+    node->filter = filter;
+  }
+#endif
+#if EVENT_BUS_DIRECT_DISPATCH == 1
+  /* The caller may reuse the old filter once this returns */
+  if (replaced) {
+    prvDirectQuiesce();
+  }
+#else
+  (void)replaced;
+#endif
+  prvSubscribe(listener, eventId, false);
+}
+
 static void prvSubscribeRemove(event_listener_t *listener, uint32_t remEvent) {
-  listener->eventMask[remEvent / 32] &= ~(1UL << (remEvent % 32));
+  configASSERT(remEvent < EVENT_BUS_BITS);
+  prvUnlinkFilter(listener, remEvent);
+  if (prvClearSub(listener, remEvent)) {
+#if EVENT_BUS_DIRECT_DISPATCH == 1
+    prvDirectQuiesce();
+#endif
+  }
+}
+
+static void prvSubscribeRemoveAll(event_listener_t *listener) {
+  bool removed = false;
+  listener->filters = NULL;
+#if EVENT_BUS_SPARSE == 1
+  while (listener->subs != NULL) {
+    removed |= prvClearSub(listener, listener->subs->eventId);
+  }
+#else
+  uint32_t i;
+  for (i = 0; i < EVENT_BUS_BITS; i++) {
+    removed |= prvClearSub(listener, i);
+  }
+#endif
+#if EVENT_BUS_DIRECT_DISPATCH == 1
+  if (removed) {
+    prvDirectQuiesce();
+  }
+#else
+  (void)removed;
+#endif
 }
 
 static void prvAttachToBus(event_listener_t *listener) {
-  event_listener_t *ev;
   configASSERT(listener);
-  if (firstListener == NULL) {
+  if (prvIsAttached(listener)) {
+    return;
+  }
+  listener->prev = lastListener;
+  listener->next = NULL;
+  if (lastListener == NULL) {
     firstListener = listener;
-    firstListener->prev = NULL;
-    firstListener->next = NULL;
   } else {
-    // Walk the list
-    ev = firstListener;
-    for (;;) {
-      if (ev->next == NULL) {
-        ev->next = listener;
-        listener->prev = ev;
-        listener->next = NULL;
-        break;
-      } else {
-        ev = ev->next;
-      }
-    }
+    lastListener->next = listener;
   }
+  lastListener = listener;
+  /* Subscriptions made while detached take effect now */
+  prvIndexListener(listener);
 }
 
 static void prvDetachFromBus(event_listener_t *listener) {
   configASSERT(listener);
-  /* If first one */
+  if (!prvIsAttached(listener)) {
+    return;
+  }
+  prvUnindexListener(listener);
+#if EVENT_BUS_DIRECT_DISPATCH == 1
+  prvDirectQuiesce();
+#endif
   if (listener->prev == NULL) {
-    /* If none following */
-    if (listener->next == NULL) {
-      firstListener = NULL;
-    } else {
-      firstListener = listener->next;
-      firstListener->prev = NULL;
-    }
+    firstListener = listener->next;
   } else {
-    if (listener->next != NULL) {
-      listener->prev->next = listener->next;
-      listener->next->prev = listener->prev;
-    } else {
-      listener->prev->next = NULL;
-    }
+    listener->prev->next = listener->next;
+  }
+  if (listener->next == NULL) {
+    lastListener = listener->prev;
+  } else {
+    listener->next->prev = listener->prev;
   }
   listener->next = listener->prev = NULL;
 }
 
+#ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
+/* A retained event satisfies the wait at once, like a subscribe would */
+static void prvWaitAdd(sub_node_t *node, uint32_t eventId) {
+  if (prvRetained(eventId) != NULL) {
+    xTaskNotifyGive(node->task);
+    return;
+  }
+  prvIndexLink(node, eventId);
+}
+
+static void prvWaitRemove(sub_node_t *node, uint32_t eventId) {
+  if (prvIndexUnlinkNode(node, eventId)) {
+#if EVENT_BUS_DIRECT_DISPATCH == 1
+    prvDirectQuiesce();
+#endif
+  }
+}
+#endif
+
+/* Time spent in the command transport, staged events count from the kick */
+static inline void prvRecordQueue(const event_t *ev, const EVENT_CMD *cmd) {
+#if EVENT_BUS_HIST == 1
+  RECORD_PHASE(ev->event, queue, EVENT_BUS_TIME_SOURCE - cmd->sentTime);
+#else
+  (void)ev;
+  (void)cmd;
+#endif
+}
+
+/* Takes what was staged when the kick arrived, later pushes kick again */
+static void prvDrainStage(event_isr_stage_t *stage, const EVENT_CMD *cmd) {
+  uint32_t head = stage->head;
+  uint32_t tail;
+  ebAtomicStore(&stage->kicked, 0);
+  tail = ebAtomicLoad(&stage->tail);
+  while (head != tail) {
+    prvRecordQueue(stage->slots[head & (stage->size - 1)], cmd);
+    prvPublishEvent(stage->slots[head & (stage->size - 1)], false, NULL);
+    ebAtomicStore(&stage->head, ++head);
+  }
+}
+
 static void prvInvdaliteEvent(event_t *event) {
   configASSERT(event);
   configASSERT(event->event < EVENT_BUS_BITS);
   /* Delete previously retained event */
-  retainedEvents[event->event] = NULL;
+  prvRetainEvent(event->event, NULL);
+}
+
+static void prvProcessCmd(EVENT_CMD *cmd) {
+  switch (cmd->command) {
+  case CMD_ATTACH:
+    prvAttachToBus(cmd->eventData);
+    break;
+  case CMD_DETACH:
+    prvDetachFromBus(cmd->eventData);
+    break;
+  case CMD_NEW_EVENT:
+    prvRecordQueue(cmd->eventData, cmd);
+    prvPublishEvent(cmd->eventData, cmd->params, NULL);
+    break;
+  case CMD_NEW_EVENT_ASYNC:
+    prvRecordQueue(cmd->eventData, cmd);
+    prvPublishEvent(cmd->eventData, false, cmd->onComplete);
+    break;
+  case CMD_NEW_EVENT_BATCH: {
+    event_t *const *evs = cmd->eventData;
+    uint32_t i;
+    for (i = 0; i < cmd->params; i++) {
+      prvRecordQueue(evs[i], cmd);
+      prvPublishEvent(evs[i], false, NULL);
+    }
+    break;
+  }
+  case CMD_INVALIDATE_EVENT:
+    prvInvdaliteEvent(cmd->eventData);
+    break;
+  case CMD_SUBSCRIBE_ADD:
+    prvSubscribeAdd(cmd->eventData, cmd->params);
+    break;
+  case CMD_SUBSCRIBE_ADD_ARRAY:
+    prvSubscribeAddArray(cmd->eventData, cmd->arrayParams);
+    break;
+#if EVENT_BUS_SPARSE != 1
+  case CMD_SUBSCRIBE_ADD_MASK:
+    prvSubscribeAddMask(cmd->eventData, cmd->arrayParams);
+    break;
+#endif
+  case CMD_SUBSCRIBE_ADD_RANGE:
+    prvSubscribeAddRange(cmd->eventData, cmd->arrayParams);
+    break;
+  case CMD_SUBSCRIBE_REMOVE:
+    prvSubscribeRemove(cmd->eventData, cmd->params);
+    break;
+  case CMD_SUBSCRIBE_REMOVE_ALL:
+    prvSubscribeRemoveAll(cmd->eventData);
+    break;
+  case CMD_SUBSCRIBE_CONFLATE:
+    prvSubscribeConflate(cmd->eventData, cmd->params);
+    break;
+  case CMD_SUBSCRIBE_FILTER:
+    prvSubscribeFilter(cmd->eventData, cmd->filter);
+    break;
+#ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
+  case CMD_WAIT_ADD:
+    prvWaitAdd(cmd->eventData, cmd->params);
+    break;
+  case CMD_WAIT_REMOVE:
+    prvWaitRemove(cmd->eventData, cmd->params);
+    break;
+#endif
+  case CMD_DRAIN_STAGE:
+    prvDrainStage(cmd->eventData, cmd);
+    break;
+  case CMD_BARRIER:
+    /* Nothing to do, the caller only wants everything before it done */
+    break;
+  default:
+    break;
+  }
+}
+
+static void prvRecordBatch(uint32_t batch) {
+  uint32_t bucket = 0;
+  while ((batch >> (bucket + 1)) != 0 && bucket < BATCH_HIST_BUCKETS - 1) {
+    bucket++;
+  }
+  batchHistogram[bucket]++;
+  if (batch > batchMax) {
+    batchMax = batch;
+  }
 }
 
 static void eventBusTasks(void *pvParameters) {
   static EVENT_CMD cmd;
+#ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
+  static TaskHandle_t waiting[EVENT_BUS_MAX_CMD_QUEUE];
+  uint32_t waitCount, i;
+#endif
+  uint32_t batch;
   (void)pvParameters;
   for (;;) {
-    xQueueReceive(xQueueCmd, &cmd, portMAX_DELAY);
-    switch (cmd.command) {
-    case CMD_ATTACH:
-      prvAttachToBus(cmd.eventData);
-      break;
-    case CMD_DETACH:
-      prvDetachFromBus(cmd.eventData);
-      break;
-    case CMD_NEW_EVENT:
-      prvPublishEvent(cmd.eventData, cmd.params);
-      break;
-    case CMD_INVALIDATE_EVENT:
-      prvInvdaliteEvent(cmd.eventData);
-      break;
-    case CMD_SUBSCRIBE_ADD:
-      prvSubscribeAdd(cmd.eventData, cmd.params);
-      break;
-    case CMD_SUBSCRIBE_ADD_ARRAY:
-      prvSubscribeAddArray(cmd.eventData, cmd.arrayParams);
-      break;
-    case CMD_SUBSCRIBE_REMOVE:
-      prvSubscribeRemove(cmd.eventData, cmd.params);      
-      break;
-    default:
-      break;
-    }
+    prvCmdReceive(&cmd, portMAX_DELAY);
+    /* Drain whatever is already pending before waking any caller */
+    batch = 0;
+#ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
+    waitCount = 0;
+#endif
+    do {
+      prvProcessCmd(&cmd);
+#if EVENT_BUS_DIRECT_DISPATCH == 1
+      (void)ebAtomicSub(&cmdPending, 1);
+#endif
+      batch++;
+#ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
+      if (cmd.xCallingTask != NULL) {
+        waiting[waitCount++] = cmd.xCallingTask;
+      }
+#endif
+    } while (batch < EVENT_BUS_MAX_CMD_QUEUE &&
+             prvCmdReceive(&cmd, 0) == pdTRUE);
+    prvRecordBatch(batch);
 #ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
-    if (cmd.xCallingTask != NULL) {
-      xTaskNotifyGiveIndexed(cmd.xCallingTask,
-                             EVENT_BUS_USE_TASK_NOTIFICATION_INDEX);
+    for (i = 0; i < waitCount; i++) {
+      xTaskNotifyGiveIndexed(waiting[i], EVENT_BUS_USE_TASK_NOTIFICATION_INDEX);
     }
 #endif
   }
@@ -265,14 +1953,7 @@ void subEvent(event_listener_t *listener, uint32_t eventId) {
   configASSERT(eventId < EVENT_BUS_BITS);
   EVENT_CMD cmd = {
       .command = CMD_SUBSCRIBE_ADD, .eventData = listener, .params = eventId};
-  cmd.xCallingTask = xTaskGetCurrentTaskHandle();
-  xQueueSendToBack(xQueueCmd, (void *)&cmd, portMAX_DELAY);
-#ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
-  ulTaskNotifyTakeIndexed(EVENT_BUS_USE_TASK_NOTIFICATION_INDEX, pdTRUE,
-                          portMAX_DELAY);
-#else
-  taskYIELD();
-#endif
+  prvCmdSendWait(&cmd);
 }
 
 void subEventList(event_listener_t *listener, const uint32_t *eventList) {
@@ -281,14 +1962,57 @@ void subEventList(event_listener_t *listener, const uint32_t *eventList) {
   EVENT_CMD cmd = {.command = CMD_SUBSCRIBE_ADD_ARRAY,
                    .eventData = listener,
                    .arrayParams = eventList};
-  cmd.xCallingTask = xTaskGetCurrentTaskHandle();
-  xQueueSendToBack(xQueueCmd, (void *)&cmd, portMAX_DELAY);
-#ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
-  ulTaskNotifyTakeIndexed(EVENT_BUS_USE_TASK_NOTIFICATION_INDEX, pdTRUE,
-                          portMAX_DELAY);
-#else
-  taskYIELD();
+  prvCmdSendWait(&cmd);
+}
+
+#if EVENT_BUS_SPARSE != 1
+void subEventMask(event_listener_t *listener,
+                  const uint32_t mask[EVENT_BUS_MASK_WIDTH]) {
+  configASSERT(listener);
+  configASSERT(mask);
+  EVENT_CMD cmd = {.command = CMD_SUBSCRIBE_ADD_MASK,
+                   .eventData = listener,
+                   .arrayParams = mask};
+  prvCmdSendWait(&cmd);
+}
 #endif
+
+void subEventRange(event_listener_t *listener, uint32_t first,
+                   uint32_t last) {
+  /* Caller waits for the bus, so the range can live on the stack */
+  const uint32_t range[2] = {first, last};
+  configASSERT(listener);
+  configASSERT(first <= last);
+  configASSERT(last < EVENT_BUS_BITS);
+  EVENT_CMD cmd = {.command = CMD_SUBSCRIBE_ADD_RANGE,
+                   .eventData = listener,
+                   .arrayParams = range};
+  prvCmdSendWait(&cmd);
+}
+
+void subEventConflated(event_listener_t *listener, uint32_t eventId) {
+  configASSERT(listener);
+  configASSERT(listener->queueHandle); /* Only queues can hold a stale event */
+  configASSERT(eventId < EVENT_BUS_BITS);
+  EVENT_CMD cmd = {.command = CMD_SUBSCRIBE_CONFLATE,
+                   .eventData = listener,
+                   .params = eventId};
+  prvCmdSendWait(&cmd);
+}
+
+void subEventFiltered(event_listener_t *listener, uint32_t eventId,
+                      event_filter_t *filter) {
+  configASSERT(listener);
+  configASSERT(filter);
+  configASSERT(eventId < EVENT_BUS_BITS);
+  configASSERT(filter->match != NULL || filter->width == 1 ||
+               filter->width == 2 || filter->width == 4);
+  /* Not linked yet, the bus only reads it once the command runs */
+  filter->eventId = eventId;
+  EVENT_CMD cmd = {.command = CMD_SUBSCRIBE_FILTER,
+                   .eventData = listener,
+                   .filter = filter};
+  prvCmdSendWait(&cmd);
 }
 
 void unSubEvent(event_listener_t *listener, uint32_t eventId) {
@@ -297,113 +2021,239 @@ void unSubEvent(event_listener_t *listener, uint32_t eventId) {
   EVENT_CMD cmd = {.command = CMD_SUBSCRIBE_REMOVE,
                    .eventData = listener,
                    .params = eventId};
-  cmd.xCallingTask = xTaskGetCurrentTaskHandle();
-  xQueueSendToBack(xQueueCmd, (void *)&cmd, portMAX_DELAY);
-#ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
-  ulTaskNotifyTakeIndexed(EVENT_BUS_USE_TASK_NOTIFICATION_INDEX, pdTRUE,
-                          portMAX_DELAY);
-#else
-  taskYIELD();
+  prvCmdSendWait(&cmd);
+}
+
+void unSubEventAll(event_listener_t *listener) {
+  configASSERT(listener);
+  EVENT_CMD cmd = {.command = CMD_SUBSCRIBE_REMOVE_ALL, .eventData = listener};
+  prvCmdSendWait(&cmd);
+}
+
+static void prvCheckListener(event_listener_t *listener) {
+  configASSERT(listener);
+  if (listener->ring != NULL) {
+    configASSERT(listener->ring->slots);
+    /* Ring size must be a power of two */
+    configASSERT(listener->ring->size != 0 &&
+                 (listener->ring->size & (listener->ring->size - 1)) == 0);
+    /* Only the owner may take events out of a ring */
+    configASSERT(listener->overflow != EVENT_OVERFLOW_DROP_OLDEST &&
+                 listener->overflow != EVENT_OVERFLOW_CONFLATE);
+  }
+#if EVENT_BUS_WORKERS > 0
+  configASSERT(listener->worker <= EVENT_BUS_WORKERS);
+  configASSERT(listener->worker == 0 || listener->callback != NULL);
 #endif
 }
 
 void attachBus(event_listener_t *listener) {
-  configASSERT(listener);
+  prvCheckListener(listener);
   EVENT_CMD cmd = {.command = CMD_ATTACH, .eventData = listener};
-  cmd.xCallingTask = xTaskGetCurrentTaskHandle();
   /* Subscribing task must have lower priority or weird things will happen */
-  if (listener->queueHandle != NULL) {
+  if (listener->queueHandle != NULL || listener->ring != NULL) {
     configASSERT(uxTaskPriorityGet(NULL) < EVENT_BUS_RTOS_PRIORITY);
   }
-  xQueueSendToBack(xQueueCmd, (void *)&cmd, portMAX_DELAY);
-#ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
-  ulTaskNotifyTakeIndexed(EVENT_BUS_USE_TASK_NOTIFICATION_INDEX, pdTRUE,
-                          portMAX_DELAY);
-#else
-  taskYIELD();
-#endif
+  prvCmdSendWait(&cmd);
 }
 
 void detachBus(event_listener_t *listener) {
   configASSERT(listener);
   EVENT_CMD cmd = {.command = CMD_DETACH, .eventData = listener};
-  cmd.xCallingTask = xTaskGetCurrentTaskHandle();
-  xQueueSendToBack(xQueueCmd, (void *)&cmd, portMAX_DELAY);
-#ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
-  ulTaskNotifyTakeIndexed(EVENT_BUS_USE_TASK_NOTIFICATION_INDEX, pdTRUE,
-                          portMAX_DELAY);
-#else
-  taskYIELD();
+  prvCmdSendWait(&cmd);
+#if EVENT_BUS_WORKERS > 0
+  /*
+   * Nothing new reaches the worker now, let the queued callbacks finish.
+   * A callback detaching from its own worker can only leave them queued.
+   */
+  if (listener->worker != 0 &&
+      xTaskGetCurrentTaskHandle() != workerTask[listener->worker - 1]) {
+    prvWorkerFlush(listener->worker - 1);
+  }
 #endif
 }
 
+BaseType_t attachBusAsync(event_listener_t *listener, TickType_t xTicksToWait) {
+  prvCheckListener(listener);
+  EVENT_CMD cmd = {.command = CMD_ATTACH, .eventData = listener};
+  return prvCmdSendDeferred(&cmd, xTicksToWait);
+}
+
+BaseType_t subEventAsync(event_listener_t *listener, uint32_t eventId,
+                         TickType_t xTicksToWait) {
+  configASSERT(listener);
+  configASSERT(eventId < EVENT_BUS_BITS);
+  EVENT_CMD cmd = {
+      .command = CMD_SUBSCRIBE_ADD, .eventData = listener, .params = eventId};
+  return prvCmdSendDeferred(&cmd, xTicksToWait);
+}
+
+BaseType_t detachBusAsync(event_listener_t *listener, TickType_t xTicksToWait) {
+  configASSERT(listener);
+  EVENT_CMD cmd = {.command = CMD_DETACH, .eventData = listener};
+  return prvCmdSendDeferred(&cmd, xTicksToWait);
+}
+
+void eventBusBarrier(void) {
+  /* Would wait on itself */
+  configASSERT(xTaskGetCurrentTaskHandle() != xBusTask);
+  /* Lanes are only ordered within themselves, so one barrier each */
+  for (uint32_t lane = 0; lane < EVENT_BUS_LANES; lane++) {
+    EVENT_CMD cmd = {.command = CMD_BARRIER, .params = lane};
+    prvCmdSendWait(&cmd);
+  }
+}
+
+#if EVENT_BUS_WORKERS > 0
+void eventWorkerFlush(void) {
+  for (uint32_t i = 0; i < EVENT_BUS_WORKERS; i++) {
+    prvWorkerFlush(i);
+  }
+}
+#endif
+
 void publishEvent(event_t *ev, bool retain) {
   configASSERT(ev);
   configASSERT(ev->event < EVENT_BUS_BITS);
-  /* Retained events must be statically allocated */
-  configASSERT(retain ? ev->dynamicAlloc == 0 : 1);
+#if EVENT_BUS_DIRECT_DISPATCH == 1
+  if (!retain && prvPublishDirect(ev)) {
+    return;
+  }
+#endif
   EVENT_CMD cmd = {.command = CMD_NEW_EVENT, .eventData = ev, .params = retain};
-  cmd.xCallingTask = xTaskGetCurrentTaskHandle();
-  xQueueSendToBack(xQueueCmd, (void *)&cmd, portMAX_DELAY);
-#ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
-  ulTaskNotifyTakeIndexed(EVENT_BUS_USE_TASK_NOTIFICATION_INDEX, pdTRUE,
-                          portMAX_DELAY);
-#else
-  taskYIELD();
+  prvCmdSendWait(&cmd);
+}
+
+void publishEventBatch(event_t *const *evs, size_t n) {
+  size_t i = 0;
+  configASSERT(evs);
+  for (i = 0; i < n; i++) {
+    configASSERT(evs[i]);
+    configASSERT(evs[i]->event < EVENT_BUS_BITS);
+  }
+  i = 0;
+#if EVENT_BUS_DIRECT_DISPATCH == 1
+  /* Once one event needs the bus the rest follow it, to keep the order */
+  while (i < n && prvPublishDirect(evs[i])) {
+    i++;
+  }
 #endif
+  if (i < n) {
+    EVENT_CMD cmd = {.command = CMD_NEW_EVENT_BATCH,
+                     .eventData = (void *)&evs[i],
+                     .params = (uint32_t)(n - i)};
+    prvCmdSendWait(&cmd);
+  }
 }
 
-BaseType_t publishEventFromISR(event_t *ev) {
+BaseType_t publishEventAsync(event_t *ev, event_complete_t onComplete,
+                             TickType_t xTicksToWait) {
+  configASSERT(ev);
+  configASSERT(ev->event < EVENT_BUS_BITS);
+  /* Bus owns the event once queued, so it must come from eventAlloc */
+  configASSERT(ev->dynamicAlloc != DYN_ALLOC_NONE);
+  EVENT_CMD cmd = {.command = CMD_NEW_EVENT_ASYNC,
+                   .eventData = ev,
+                   .onComplete = onComplete};
+  cmd.xCallingTask = NULL;
+  if (prvCmdSend(&cmd, xTicksToWait) != pdTRUE) {
+    configASSERT(ev->refCount == 0);
+    prvEventFree(ev);
+    return pdFAIL;
+  }
+  return pdPASS;
+}
+
+BaseType_t publishEventFromISR(event_t *ev,
+                               BaseType_t *pxHigherPriorityTaskWoken) {
   configASSERT(ev);
   configASSERT(ev->event < EVENT_BUS_BITS);
   EVENT_CMD cmd = {
       .command = CMD_NEW_EVENT, .eventData = ev, .params = 0};
   cmd.xCallingTask = NULL;
-  return xQueueSendToBackFromISR(xQueueCmd, (void *)&cmd, NULL) == pdTRUE;
+  return prvCmdSendFromISR(&cmd, pxHigherPriorityTaskWoken) == pdTRUE;
+}
+
+BaseType_t publishEventStaged(event_isr_stage_t *stage, event_t *ev,
+                              BaseType_t *pxHigherPriorityTaskWoken) {
+  configASSERT(stage);
+  configASSERT(ev);
+  configASSERT(ev->event < EVENT_BUS_BITS);
+  /* Stage size must be a power of two */
+  configASSERT(stage->size != 0 && (stage->size & (stage->size - 1)) == 0);
+  uint32_t tail = stage->tail;
+  if (tail - ebAtomicLoad(&stage->head) >= stage->size) {
+    return pdFALSE;
+  }
+  stage->slots[tail & (stage->size - 1)] = ev;
+  ebAtomicStore(&stage->tail, tail + 1);
+  /* Bus clears kicked before it reads tail, so this push is never missed */
+  if (ebAtomicLoad(&stage->kicked) == 0) {
+    EVENT_CMD cmd = {.command = CMD_DRAIN_STAGE, .eventData = stage};
+    cmd.xCallingTask = NULL;
+    ebAtomicStore(&stage->kicked, 1);
+    if (prvCmdSendFromISR(&cmd, pxHigherPriorityTaskWoken) != pdTRUE) {
+      /* Stays staged, the next push tries the kick again */
+      ebAtomicStore(&stage->kicked, 0);
+    }
+  }
+  return pdTRUE;
 }
 
 BaseType_t publishToListener(event_listener_t *listener, event_t *ev,
                              TickType_t xTicksToWait) {
   configASSERT(ev);
+  configASSERT(ev->event < EVENT_BUS_BITS);
   configASSERT(listener);
   configASSERT(listener->queueHandle);
-  vTaskSuspendAll(); /* May not be necessary */
   if (ev->dynamicAlloc) {
-    ev->refCount++;
-    listener->refCount++;
+    (void)ebAtomicAdd16(&ev->refCount, 1);
+    (void)ebAtomicAdd16(&listener->refCount, 1);
   }
-  ev->publishTime = EVENT_BUS_TIME_SOURCE;
-  xTaskResumeAll();
+  STAMP_PUBLISH(ev);
   EVENT_BUS_DEBUG_PUB_PRV_EVENT(listener->name, ev->event);
+  TRACE(DELIVER, ev, listener);
   BaseType_t ret = xQueueSendToBack(listener->queueHandle, &ev, xTicksToWait);
   if (!ret) {
+    TRACE(DROP, ev, listener);
     eventRelease(ev, listener);
   }
   return ret;
 }
 
+void eventSetLane(uint32_t eventId, uint32_t lane) {
+  configASSERT(eventId < EVENT_BUS_BITS);
+  configASSERT(lane < EVENT_BUS_LANES);
+  prvSetEventLane(eventId, lane);
+}
+
 void invalidateEvent(event_t *ev) {
   configASSERT(ev);
   EVENT_CMD cmd = {.command = CMD_INVALIDATE_EVENT, .eventData = ev};
-  cmd.xCallingTask = xTaskGetCurrentTaskHandle();
-  xQueueSendToBack(xQueueCmd, (void *)&cmd, portMAX_DELAY);
-#ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
-  ulTaskNotifyTakeIndexed(EVENT_BUS_USE_TASK_NOTIFICATION_INDEX, pdTRUE,
-                          portMAX_DELAY);
-#else
-  taskYIELD();
-#endif
+  prvCmdSendWait(&cmd);
 }
 
 #ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
+/*
+ * The waiter node lives on this stack and goes straight into the index.
+ * The bus unlinks it before the wakeup, so only a timeout costs a round
+ * trip to take it back out.
+ */
 BaseType_t waitEvent(uint32_t event, uint32_t waitTicks) {
-  event_listener_t listener = {0};
-  listener.waitingTask = xTaskGetCurrentTaskHandle();
-  attachBus(&listener);
-  subEvent(&listener, event);
+  sub_node_t waiter = {0};
+  configASSERT(event < EVENT_BUS_BITS);
+  waiter.task = xTaskGetCurrentTaskHandle();
+  waiter.waiter = 1;
+#if EVENT_BUS_SPARSE == 1
+  waiter.eventId = event;
+#endif
+  EVENT_CMD cmd = {
+      .command = CMD_WAIT_ADD, .eventData = &waiter, .params = event};
+  (void)prvCmdSendDeferred(&cmd, portMAX_DELAY);
   uint32_t ret = ulTaskNotifyTake(pdTRUE, waitTicks);
-  detachBus(&listener);
   if (ret == 0) {
+    cmd.command = CMD_WAIT_REMOVE;
+    prvCmdSendWait(&cmd);
     /* Make sure we didn't get one from a race cond */
     ret = ulTaskNotifyTake(pdTRUE, 0);
   }
@@ -412,100 +2262,260 @@ BaseType_t waitEvent(uint32_t event, uint32_t waitTicks) {
 #endif
 
 TaskHandle_t initEventBus(void) {
-  static TaskHandle_t processHandle = NULL;
 #ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
   configASSERT(EVENT_BUS_USE_TASK_NOTIFICATION_INDEX > 0);
 #endif
+#if EVENT_BUS_SPARSE != 1 || EVENT_BUS_CMD_TRANSPORT == EVENT_BUS_TRANSPORT_QUEUE
+  uint32_t lane;
+#endif
+#if EVENT_BUS_SPARSE != 1
+  for (lane = 0; lane < EVENT_BUS_BITS; lane++) {
+    eventLane[lane] = EVENT_BUS_LANES - 1;
+  }
+#endif
+#if EVENT_BUS_CMD_TRANSPORT == EVENT_BUS_TRANSPORT_RING
+  /* Ring must be ready before the bus task can look at it */
+  prvRingInit();
+#endif
 #if EVENT_BUS_DYNAMIC_FREERTOS == 1
-  (void)xTaskCreate(eventBusTasks, "Event-Bus", STACK_SIZE, NULL, EVENT_BUS_RTOS_PRIORITY, &processHandle);
-  xQueueCmd = xQueueCreate(EVENT_BUS_MAX_CMD_QUEUE, sizeof(EVENT_CMD));
+#if EVENT_BUS_CMD_TRANSPORT == EVENT_BUS_TRANSPORT_QUEUE
+  for (lane = 0; lane < EVENT_BUS_LANES; lane++) {
+    xQueueCmd[lane] = xQueueCreate(EVENT_BUS_MAX_CMD_QUEUE, sizeof(EVENT_CMD));
+  }
+#endif
+  (void)xTaskCreate(eventBusTasks, "Event-Bus", STACK_SIZE, NULL, EVENT_BUS_RTOS_PRIORITY, &xBusTask);
 #else
-  processHandle =
+#if EVENT_BUS_CMD_TRANSPORT == EVENT_BUS_TRANSPORT_QUEUE
+  for (lane = 0; lane < EVENT_BUS_LANES; lane++) {
+    xQueueCmd[lane] =
+        xQueueCreateStatic(EVENT_BUS_MAX_CMD_QUEUE, sizeof(EVENT_CMD),
+                           ucQueueStorage[lane], &xStaticQueue[lane]);
+  }
+#endif
+  xBusTask =
       xTaskCreateStatic(eventBusTasks, "Event-Bus", STACK_SIZE, NULL,
           EVENT_BUS_RTOS_PRIORITY, xStack, &xTaskBuffer);
-  xQueueCmd = xQueueCreateStatic(EVENT_BUS_MAX_CMD_QUEUE, sizeof(EVENT_CMD),
-      ucQueueStorage, &xStaticQueue);
 #endif
 
-  mp_init(POOL_SIZE_CALC(EVENT_BUS_POOL_SM_SZ), EVENT_BUS_POOL_SM_CT,
-      smEventPool, &mpSmall);
-  mp_init(POOL_SIZE_CALC(EVENT_BUS_POOL_MD_SZ), EVENT_BUS_POOL_MD_CT,
-      mdEventPool, &mpMed);
-  mp_init(POOL_SIZE_CALC(EVENT_BUS_POOL_LG_SZ), EVENT_BUS_POOL_LG_CT,
-      lgEventPool, &mpLarge);
+  uint8_t *region = eventPoolStorage;
+  for (DYN_ALLOC_T cls = 1; cls < POOL_CLASSES; cls++) {
+    /* Lookup is a binary search, the table must be ascending */
+    configASSERT(poolBlockSize[cls] > poolBlockSize[cls - 1]);
+    /* Fails on a block size the pool cannot hold; kept outside configASSERT
+       so the init still runs when asserts compile out */
+    int rc = EV_POOL_INIT(poolBlockSize[cls], poolBlockCount[cls], region,
+                          &eventPools[cls]);
+    configASSERT(rc == 0);
+    (void)rc;
+    region += (poolBlockCount[cls] * poolBlockSize[cls] + 7) & ~(size_t)7;
+  }
+  configASSERT(region == eventPoolStorage + sizeof(eventPoolStorage));
+  extClass = prvPoolClass(sizeof(event_ext_t));
+  mp_init(sizeof(sub_node_t), EVENT_BUS_MAX_SUBSCRIPTIONS, subNodePool,
+      &mpSubNodes);
+#if EVENT_BUS_WORKERS > 0
+  prvWorkersInit();
+#endif
 #ifdef TRC_USE_TRACEALYZER_RECORDER
-#if DEBUG
-  vTraceSetQueueName(xQueueCmd, "events");
+#if DEBUG && EVENT_BUS_CMD_TRANSPORT == EVENT_BUS_TRANSPORT_QUEUE
+  vTraceSetQueueName(xQueueCmd[0], "events");
 #endif
 #endif
-  return processHandle;
+  return xBusTask;
 }
 
-void *eventAlloc(size_t size, uint32_t eventId, uint16_t publisherId) {
+static event_t *prvEventAllocate(size_t size, uint32_t eventId,
+                                 uint16_t publisherId) {
   event_t *val = NULL;
-  DYN_ALLOC_T dyn = DYN_ALLOC_NONE;
+  DYN_ALLOC_T dyn;
   configASSERT(size >= sizeof(event_t));
-  configASSERT(size <= POOL_SIZE_CALC(EVENT_BUS_POOL_LG_SZ));
-  vTaskSuspendAll();
-  if (size <= POOL_SIZE_CALC(EVENT_BUS_POOL_SM_SZ)) {
-    val = mp_malloc(&mpSmall);
-    dyn = DYN_ALLOC_SMALL;
-  } else if (size <= POOL_SIZE_CALC(EVENT_BUS_POOL_MD_SZ)) {
-    val = mp_malloc(&mpMed);
-    dyn = DYN_ALLOC_MED;
-  } else if (size <= POOL_SIZE_CALC(EVENT_BUS_POOL_LG_SZ)) {
-    val = mp_malloc(&mpLarge);
-    dyn = DYN_ALLOC_LARGE;
-  } else {
+  /* event_t.event is 16 bits, out of range IDs would be truncated */
+  configASSERT(eventId < EVENT_BUS_BITS);
+  dyn = prvPoolClass(size);
+  if (dyn == DYN_ALLOC_NONE) {
     configASSERT(0); /* Size not allowed */
+    return NULL;
   }
+  val = prvPoolMalloc(dyn);
+  prvPoolWatch(dyn);
+  if (val != NULL) {
+    /* 64 bit so long soaks never wrap, no portable atomics that wide */
+    UBaseType_t mask = taskENTER_CRITICAL_FROM_ISR();
+    poolAllocs[dyn]++;
+    poolReqBytes[dyn] += size;
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+    val->dynamicAlloc = dyn;
+    val->refCount = 0;
+    val->event = eventId;
+    val->publisherId = publisherId;
+    val->published = 0;
+  }
+  return val;
+}
+
+void *eventAlloc(size_t size, uint32_t eventId, uint16_t publisherId) {
+  event_t *val = prvEventAllocate(size, eventId, publisherId);
   configASSERT(val);
-  val->dynamicAlloc = dyn;
-  val->refCount = 0;
-  val->event = eventId;
-  val->publisherId = publisherId;
-  xTaskResumeAll();
   return (void *)val;
 }
 
+void *eventTryAlloc(size_t size, uint32_t eventId, uint16_t publisherId) {
+  return (void *)prvEventAllocate(size, eventId, publisherId);
+}
+
+uint32_t eventPoolFree(size_t size) {
+  DYN_ALLOC_T cls = prvPoolClass(size);
+  return cls == DYN_ALLOC_NONE ? 0 : prvClassFree(cls);
+}
+
+void eventPoolSetLowWater(size_t size, uint32_t level, event_pool_low_t onLow) {
+  DYN_ALLOC_T cls = prvPoolClass(size);
+  configASSERT(cls != DYN_ALLOC_NONE); /* Size not allowed */
+  ebAtomicStore(&poolLowLevel[cls], 0);
+  poolLowCb[cls] = onLow;
+  ebAtomicStore(&poolLowState[cls], 0);
+  ebAtomicStore(&poolLowLevel[cls], level);
+  /* Report a class that is already low straight away */
+  prvPoolWatch(cls);
+}
+
+#if EVENT_BUS_POOL_LOCKFREE == 1
+void *eventAllocFromISR(size_t size, uint32_t eventId, uint16_t publisherId) {
+  /* No assert, an ISR has to cope with an exhausted pool */
+  return (void *)prvEventAllocate(size, eventId, publisherId);
+}
+#endif
+
+event_ext_t *eventAllocExt(uint32_t eventId, uint16_t publisherId, void *data,
+                           size_t len, event_ext_release_t release,
+                           void *ctx) {
+  configASSERT(extClass != DYN_ALLOC_NONE); /* No class fits event_ext_t */
+  event_ext_t *ext =
+      (event_ext_t *)prvEventAllocate(sizeof(event_ext_t), eventId, publisherId);
+  configASSERT(ext);
+  ext->e.dynamicAlloc = DYN_ALLOC_EXTERNAL;
+  ext->data = data;
+  ext->len = len;
+  ext->release = release;
+  ext->ctx = ctx;
+  return ext;
+}
+
+/* Drops one reference, the last holder records the response and frees */
+static void prvReleaseEvent(event_t *ev, event_listener_t *listener) {
+  uint16_t prev = ebAtomicSub16(&ev->refCount, 1);
+  configASSERT(prev > 0); /* Too many releases */
+  /* Only the last holder touches the stats and the pool */
+  if (prev == 1) {
+#if EVENT_BUS_PUBLISH_TIME == 1
+    EVENT_STATS *stats =
+        ev->event < EVENT_BUS_BITS ? prvStats(ev->event) : NULL;
+    if (stats != NULL && ev->published) {
+      uint32_t evResponse = EVENT_BUS_TIME_SOURCE - ev->publishTime;
+      if (evResponse > stats->maxResponse) {
+        stats->maxResponse = evResponse;
+        stats->maxList = listener;
+      }
+      if (evResponse < stats->minResponse || !stats->minResponse) {
+        stats->minResponse = evResponse;
+      }
+    }
+#else
+    (void)listener;
+#endif
+    prvEventFree(ev);
+  }
+}
+
+/* Static events are timed too, so call before any reference is dropped */
+static inline void prvRecordHold(event_t *ev, event_listener_t *listener) {
+#if EVENT_BUS_HIST == 1
+  uint32_t held;
+  if (ev->published && ev->event < EVENT_BUS_BITS) {
+    held = EVENT_BUS_TIME_SOURCE - ev->publishTime;
+    RECORD_PHASE(ev->event, hold, held);
+    if (listener->hist != NULL) {
+      prvHistAdd(listener->hist->hold, held);
+    }
+  }
+#else
+  (void)ev;
+  (void)listener;
+#endif
+}
+
 void eventRelease(event_t *ev, event_listener_t *listener) {
   configASSERT(ev);
   configASSERT(listener);
-  uint32_t evResponse;
-  vTaskSuspendAll();
+  prvRecordHold(ev, listener);
+  TRACE(RELEASE, ev, listener);
   if (ev->dynamicAlloc) {
-    configASSERT(ev->refCount > 0);       /* Too many releases */
     configASSERT(listener->refCount > 0); /* NOTE: Too many releases */
-    ev->refCount--;
-    listener->refCount--;
-    if (ev->refCount == 0) {
-      if (ev->event < EVENT_BUS_BITS && ev->published) {
-        evResponse = EVENT_BUS_TIME_SOURCE - ev->publishTime;
-        if (evResponse > eventMaxResponse[ev->event]) {
-          eventMaxResponse[ev->event] = evResponse;
-          eventMaxRespList[ev->event] = listener;
-        }
-        if (evResponse < eventMinResponse[ev->event] || !eventMinResponse[ev->event]) {
-          eventMinResponse[ev->event] = evResponse;
-        }
-      }
-      switch (ev->dynamicAlloc) {
-      default:
-        configASSERT(ev->dynamicAlloc <= DYN_ALLOC_LARGE);
-        break;
-      case DYN_ALLOC_SMALL:
-        mp_free(&mpSmall, ev);
-        break;
-      case DYN_ALLOC_MED:
-        mp_free(&mpMed, ev);
-        break;
-      case DYN_ALLOC_LARGE:
-        mp_free(&mpLarge, ev);
-        break;
-      }
+    (void)ebAtomicSub16(&listener->refCount, 1);
+    prvReleaseEvent(ev, listener);
+  }
+}
+
+void eventReleaseBatch(event_t *const *evs, size_t n,
+                       event_listener_t *listener) {
+  uint16_t held = 0;
+  size_t i;
+  configASSERT(evs);
+  configASSERT(listener);
+  for (i = 0; i < n; i++) {
+    configASSERT(evs[i]);
+    prvRecordHold(evs[i], listener);
+    TRACE(RELEASE, evs[i], listener);
+    if (evs[i]->dynamicAlloc) {
+      prvReleaseEvent(evs[i], listener);
+      held++;
     }
   }
-  xTaskResumeAll();
+  configASSERT(listener->refCount >= held); /* NOTE: Too many releases */
+  (void)ebAtomicSub16(&listener->refCount, held);
+}
+
+size_t eventReceiveBatch(event_listener_t *listener, event_t **out, size_t max,
+                         TickType_t xTicksToWait) {
+  event_ring_t *ring;
+  uint32_t head, avail;
+  size_t i;
+  TimeOut_t xTimeOut;
+  configASSERT(listener);
+  configASSERT(listener->ring);
+  configASSERT(out);
+  configASSERT(EVENT_BUS_RING_NOTIFY_INDEX <
+               configTASK_NOTIFICATION_ARRAY_ENTRIES);
+  ring = listener->ring;
+  head = ring->head;
+  vTaskSetTimeOutState(&xTimeOut);
+  for (;;) {
+    avail = ebAtomicLoad(&ring->tail) - head;
+    if (avail != 0 || xTicksToWait == 0) {
+      break;
+    }
+    /* Publish the waiter, then look again so a push in between is seen */
+    ebAtomicStorePtr((void *volatile *)&ring->waiting,
+                     xTaskGetCurrentTaskHandle());
+    avail = ebAtomicLoad(&ring->tail) - head;
+    if (avail == 0) {
+      (void)ulTaskNotifyTakeIndexed(EVENT_BUS_RING_NOTIFY_INDEX, pdTRUE,
+                                    xTicksToWait);
+    }
+    ebAtomicStorePtr((void *volatile *)&ring->waiting, NULL);
+    /* A stale notification wakes early, the rest of the wait still counts */
+    if (xTaskCheckForTimeOut(&xTimeOut, &xTicksToWait) != pdFALSE) {
+      xTicksToWait = 0;
+    }
+  }
+  if (avail > max) {
+    avail = (uint32_t)max;
+  }
+  for (i = 0; i < avail; i++) {
+    out[i] = ring->slots[(head + i) & (ring->size - 1)];
+  }
+  ebAtomicStore(&ring->head, head + avail);
+  return avail;
 }
 
 uint32_t eventListenerInfo(char * const buf, uint32_t bufLen) {
@@ -534,65 +2544,247 @@ uint32_t eventListenerInfo(char * const buf, uint32_t bufLen) {
 
 uint32_t eventResponseInfo(char *const buf, uint32_t bufLen) {
   uint32_t pLen;
-  uint32_t i;
+  uint32_t i, id;
+  EVENT_STATS *stats;
   pLen = snprintf(buf, bufLen, "ID     min(ms)   max(ms)\r\n");
   if (pLen >= bufLen) {
     return bufLen;
   }
   vTaskSuspendAll();
+#if EVENT_BUS_SPARSE == 1
+  for (i = 0; i < eventRecCount; i++) {
+    id = eventRecs[i].id;
+    stats = &eventRecs[i].stats;
+    if (id == EVENT_REC_FREE) {
+      continue;
+    }
+#else
   for (i = 0; i < EVENT_BUS_BITS; i++) {
-    if (eventMinResponse[i] || eventMaxResponse[i]) {
-      pLen += snprintf(&buf[pLen], bufLen - pLen, "%2i  %4i.%03i  %4i.%03i (%s)\r\n", i,
-          eventMinResponse[i] / EVENT_BUS_TIME_DIV_US / 1000,
-          eventMinResponse[i] / EVENT_BUS_TIME_DIV_US % 1000,
-          eventMaxResponse[i] / EVENT_BUS_TIME_DIV_US / 1000,
-          eventMaxResponse[i] / EVENT_BUS_TIME_DIV_US % 1000,
-          eventMaxRespList[i] == NULL ? "?" : eventMaxRespList[i]->name);
+    id = i;
+    stats = &eventStats[i];
+#endif
+    if (stats->minResponse || stats->maxResponse) {
+      pLen += snprintf(&buf[pLen], bufLen - pLen, "%2i  %4i.%03i  %4i.%03i (%s)\r\n", id,
+          stats->minResponse / EVENT_BUS_TIME_DIV_US / 1000,
+          stats->minResponse / EVENT_BUS_TIME_DIV_US % 1000,
+          stats->maxResponse / EVENT_BUS_TIME_DIV_US / 1000,
+          stats->maxResponse / EVENT_BUS_TIME_DIV_US % 1000,
+          stats->maxList == NULL ? "?" : stats->maxList->name);
       if (pLen >= bufLen) {
         xTaskResumeAll();
         return bufLen;
       }
-      eventMinResponse[i] = eventMaxResponse[i] = 0;
-      eventMaxRespList[i] = NULL;
+      stats->minResponse = stats->maxResponse = 0;
+      stats->maxList = NULL;
     }
   }
   xTaskResumeAll();
   return pLen;
 }
 
+#if EVENT_BUS_HIST == 1
+BaseType_t eventHistSnapshot(uint32_t eventId, event_hist_t *out) {
+  EVENT_STATS *stats;
+  uint32_t i;
+  configASSERT(out);
+  configASSERT(eventId < EVENT_BUS_BITS);
+  stats = prvStats(eventId);
+  if (stats == NULL) {
+    return pdFAIL;
+  }
+  /* Buckets are read one at a time, counting never stops for this */
+  for (i = 0; i < EVENT_BUS_HIST_BUCKETS; i++) {
+    out->queue[i] = stats->hist.queue[i];
+    out->dispatch[i] = stats->hist.dispatch[i];
+    out->hold[i] = stats->hist.hold[i];
+  }
+  return pdPASS;
+}
+#endif
+
+#if EVENT_BUS_TRACE == 1
+uint32_t eventTraceRead(uint32_t *cursor, event_trace_rec_t *out,
+                        uint32_t max) {
+  volatile event_trace_rec_t *rec;
+  uint32_t pos, head, n = 0;
+  uint8_t type;
+  configASSERT(cursor);
+  configASSERT(out);
+  pos = *cursor;
+  head = ebAtomicLoad(&traceHead);
+  while (n < max && pos != head) {
+    if (head - pos > EVENT_BUS_TRACE_SIZE) {
+      pos = head - EVENT_BUS_TRACE_SIZE;
+    }
+    rec = &traceRing[pos & (EVENT_BUS_TRACE_SIZE - 1)];
+    type = rec->type;
+    if (type == 0) {
+      break;
+    }
+    out[n].time = rec->time;
+    out[n].event = rec->event;
+    out[n].listener = rec->listener;
+    out[n].eventId = rec->eventId;
+    out[n].seq = rec->seq;
+    out[n].type = type;
+    /* A writer lapping the reader may have torn the copy, catch up */
+    head = ebAtomicLoad(&traceHead);
+    if (head - pos > EVENT_BUS_TRACE_SIZE) {
+      continue;
+    }
+    n++;
+    pos++;
+  }
+  *cursor = pos;
+  return n;
+}
+#endif
+
+#if EVENT_BUS_STATS == 1
+BaseType_t eventStatsSnapshot(uint32_t eventId, event_stats_t *out) {
+  EVENT_STATS *stats;
+  configASSERT(out);
+  configASSERT(eventId < EVENT_BUS_BITS);
+  stats = prvStats(eventId);
+  if (stats == NULL) {
+    return pdFAIL;
+  }
+  out->publishes = stats->publishes;
+  out->minResponse = stats->minResponse;
+  out->maxResponse = stats->maxResponse;
+  return pdPASS;
+}
+
+void eventListenerStats(const event_listener_t *listener,
+                        event_listener_stats_t *out) {
+  configASSERT(listener);
+  configASSERT(out);
+  out->delivered = listener->delivered;
+  out->dropped = listener->dropped;
+  out->inFlight = listener->refCount;
+}
+
+void eventBusStats(event_bus_stats_t *out) {
+  uint32_t i;
+  configASSERT(out);
+  /* Plain counters owned by the bus task, copy them in one piece */
+  vTaskSuspendAll();
+  for (i = 0; i < EVENT_BUS_LANES; i++) {
+    out->laneCommands[i] = laneCount[i];
+    out->laneHighWater[i] = laneHighWater[i];
+  }
+  out->batchMax = batchMax;
+  xTaskResumeAll();
+  out->cmdSendFails = cmdSendFails;
+}
+#endif
+
 uint32_t eventPoolInfo(char *const buf, uint32_t bufLen) {
   uint32_t pLen;
-  mp_info_t info1, info2, info3;
-  uint32_t res1, res2, res3;
+  mp_info_t info[POOL_CLASSES];
+  uint32_t res[POOL_CLASSES];
+  uint64_t allocs[POOL_CLASSES];
+  uint64_t req[POOL_CLASSES];
+  uint32_t i;
+  UBaseType_t mask;
+#if EVENT_BUS_POOL_CACHE_SZ > 0
+  uint32_t cached[POOL_CLASSES] = {0};
+  uint32_t hits[POOL_CLASSES] = {0};
+  uint32_t misses[POOL_CLASSES] = {0};
+  uint32_t core;
+#endif
   vTaskSuspendAll();
-  res1 = mp_integrity(&mpSmall, &info1);
-  res2 = mp_integrity(&mpMed, &info2);
-  res3 = mp_integrity(&mpLarge, &info3);
+  for (i = 1; i < POOL_CLASSES; i++) {
+    res[i] = EV_POOL_INTEGRITY(&eventPools[i], &info[i]);
+    mask = taskENTER_CRITICAL_FROM_ISR();
+    allocs[i] = poolAllocs[i];
+    req[i] = poolReqBytes[i];
+    taskEXIT_CRITICAL_FROM_ISR(mask);
+#if EVENT_BUS_POOL_CACHE_SZ > 0
+    for (core = 0; core < EVENT_BUS_NUM_CORES; core++) {
+      cached[i] += poolCache[core][i].count;
+      hits[i] += poolCache[core][i].hits;
+      misses[i] += poolCache[core][i].misses;
+    }
+#endif
+  }
   xTaskResumeAll();
-  pLen = snprintf(buf, bufLen, "Pool   Used  Free / Total  Max  Size  Valid\r\n");
+#if EVENT_BUS_POOL_CACHE_SZ > 0
+  pLen = snprintf(buf, bufLen, "Pool   Used  Free / Total  Max  Size  Valid"
+                               "  Waste  Cached      Hit     Miss\r\n");
+#else
+  pLen = snprintf(buf, bufLen,
+                  "Pool   Used  Free / Total  Max  Size  Valid  Waste\r\n");
+#endif
   if (pLen >= bufLen) {
     return bufLen;
   }
-  pLen += snprintf(&buf[pLen], bufLen - pLen,
-                   " Small %4i  %4i / %4i  %4i  %4i  %4s\r\n", info1.count,
-                   info1.freeCount, info1.blockCount, info1.high_water,
-                   EVENT_BUS_POOL_SM_SZ, res1 ? "YES" : "NO");
-  if (pLen >= bufLen) {
-    return bufLen;
+  for (i = 1; i < POOL_CLASSES; i++) {
+    /* Mean bytes per allocation handed out but not asked for */
+    uint32_t waste =
+        allocs[i] ? poolBlockSize[i] - (uint32_t)(req[i] / allocs[i]) : 0;
+    pLen += snprintf(&buf[pLen], bufLen - pLen,
+                     " %-5i %4i  %4i / %4i  %4i  %4i  %4s  %5i", i,
+                     info[i].count, info[i].freeCount, info[i].blockCount,
+                     info[i].high_water,
+                     (int)(poolBlockSize[i] - sizeof(event_t)),
+                     res[i] ? "YES" : "NO", waste);
+    if (pLen >= bufLen) {
+      return bufLen;
+    }
+#if EVENT_BUS_POOL_CACHE_SZ > 0
+    pLen += snprintf(&buf[pLen], bufLen - pLen, "  %6i %8i %8i", cached[i],
+                     hits[i], misses[i]);
+    if (pLen >= bufLen) {
+      return bufLen;
+    }
+#endif
+    pLen += snprintf(&buf[pLen], bufLen - pLen, "\r\n");
+    if (pLen >= bufLen) {
+      return bufLen;
+    }
   }
-  pLen += snprintf(&buf[pLen], bufLen - pLen,
-                   " Med   %4i  %4i / %4i  %4i  %4i  %4s\r\n", info2.count,
-                   info2.freeCount, info2.blockCount, info2.high_water,
-                   EVENT_BUS_POOL_MD_SZ, res2 ? "YES" : "NO");
-  if (pLen >= bufLen) {
-    return bufLen;
+  return pLen;
+}
+
+uint32_t eventBatchInfo(char *const buf, uint32_t bufLen) {
+  uint32_t pLen;
+  uint32_t i;
+  uint32_t hist[BATCH_HIST_BUCKETS];
+  uint32_t max;
+  vTaskSuspendAll();
+  for (i = 0; i < BATCH_HIST_BUCKETS; i++) {
+    hist[i] = batchHistogram[i];
+  }
+  max = batchMax;
+#if EVENT_BUS_LANES > 1
+  uint32_t lanes[EVENT_BUS_LANES];
+  for (i = 0; i < EVENT_BUS_LANES; i++) {
+    lanes[i] = laneCount[i];
   }
-  pLen += snprintf(&buf[pLen], bufLen - pLen,
-                   " Large %4i  % 4i / %4i  %4i  %4i  %4s\r\n", info3.count,
-                   info3.freeCount, info3.blockCount, info3.high_water,
-                   EVENT_BUS_POOL_LG_SZ, res3 ? "YES" : "NO");
+#endif
+  xTaskResumeAll();
+  pLen = snprintf(buf, bufLen, "Batch      Count  (max %i)\r\n", max);
   if (pLen >= bufLen) {
     return bufLen;
   }
+  for (i = 0; i < BATCH_HIST_BUCKETS; i++) {
+    if (hist[i]) {
+      pLen += snprintf(&buf[pLen], bufLen - pLen, " %4i-%-4i %6i\r\n",
+                       1U << i, (2U << i) - 1, hist[i]);
+      if (pLen >= bufLen) {
+        return bufLen;
+      }
+    }
+  }
+#if EVENT_BUS_LANES > 1
+  for (i = 0; i < EVENT_BUS_LANES; i++) {
+    pLen += snprintf(&buf[pLen], bufLen - pLen, " Lane %-4i %6i\r\n", i,
+                     lanes[i]);
+    if (pLen >= bufLen) {
+      return bufLen;
+    }
+  }
+#endif
   return pLen;
 }
\ No newline at end of file
@@ -28,13 +28,37 @@
 #define EVENT_BUS_VERSION "0.50.02"
 
 #define EVENT_BUS_FLAGS_RETAIN (1UL << 0)
-#define EVENT_BUS_BITS (32 * EVENT_BUS_MASK_WIDTH)
 #define EVENT_BUS_LAST_PARAM (EVENT_BUS_BITS + 1)
 
+/* Command transports for EVENT_BUS_CMD_TRANSPORT */
+#define EVENT_BUS_TRANSPORT_QUEUE 0
+#define EVENT_BUS_TRANSPORT_RING 1
+
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stddef.h>
 
 #include "event_bus_config.h"
+
+/* Optional hooks, the config may route them to a tracer or a log */
+#ifndef EVENT_BUS_DEBUG_PUB_EVENT
+#define EVENT_BUS_DEBUG_PUB_EVENT(eventId)
+#endif
+#ifndef EVENT_BUS_DEBUG_PUB_PRV_EVENT
+#define EVENT_BUS_DEBUG_PUB_PRV_EVENT(name, eventId)
+#endif
+#ifndef EVENT_BUS_DEBUG_QUEUE_FULL
+#define EVENT_BUS_DEBUG_QUEUE_FULL(name)
+#endif
+/* EVENT_BUS_TIME_SOURCE counts per microsecond, for eventResponseInfo */
+#ifndef EVENT_BUS_TIME_DIV_US
+#define EVENT_BUS_TIME_DIV_US 1
+#endif
+/* Read for commands sent from ISRs, xTaskGetTickCountFromISR() for ticks */
+#ifndef EVENT_BUS_TIME_SOURCE_FROM_ISR
+#define EVENT_BUS_TIME_SOURCE_FROM_ISR EVENT_BUS_TIME_SOURCE
+#endif
+
 #include <FreeRTOS.h>
 #include <queue.h>
 #include <task.h>
@@ -43,9 +67,190 @@
 #define EVENT_BUS_RTOS_PRIORITY (configMAX_PRIORITIES - 2)
 #endif
 
+/*
+ * 1 to keep subscriptions, retained events, lanes and stats in hashed
+ * per-event records instead of EVENT_BUS_BITS sized tables, so memory
+ * follows the IDs in use rather than the size of the ID space.
+ */
+#ifndef EVENT_BUS_SPARSE
+#define EVENT_BUS_SPARSE 0
+#endif
+
+#if EVENT_BUS_SPARSE == 1
+/* Event IDs run from 0 to EVENT_BUS_SPARSE_IDS - 1 */
+#ifndef EVENT_BUS_SPARSE_IDS
+#define EVENT_BUS_SPARSE_IDS 4096
+#endif
+/*
+ * Distinct IDs that can be subscribed, retained or laned at once. A record
+ * left with none of those is freed, its stats with it, and reused within
+ * its hash bucket.
+ */
+#ifndef EVENT_BUS_SPARSE_EVENTS
+#define EVENT_BUS_SPARSE_EVENTS 64
+#endif
+#ifndef EVENT_BUS_SPARSE_BUCKETS
+#define EVENT_BUS_SPARSE_BUCKETS 32
+#endif
+#if (EVENT_BUS_SPARSE_BUCKETS & (EVENT_BUS_SPARSE_BUCKETS - 1)) != 0
+#error EVENT_BUS_SPARSE_BUCKETS must be a power of two
+#endif
+#define EVENT_BUS_BITS EVENT_BUS_SPARSE_IDS
+#else
 #ifndef EVENT_BUS_MASK_WIDTH
 #error EVENT_BUS_MASK_WIDTH must be declared in config file
 #endif
+#define EVENT_BUS_BITS (32 * EVENT_BUS_MASK_WIDTH)
+#endif
+/* event_t holds IDs in 16 bits */
+#if EVENT_BUS_BITS > 0x10000
+#error EVENT_BUS_BITS is limited to 65536 IDs
+#endif
+
+#ifndef EVENT_BUS_CMD_TRANSPORT
+#define EVENT_BUS_CMD_TRANSPORT EVENT_BUS_TRANSPORT_QUEUE
+#endif
+
+/*
+ * Pool size classes as X(payload bytes, block count), ascending, at most 7.
+ * Blocks are rounded up to a multiple of 8, so two payload sizes that round
+ * to the same block are rejected at init. Defaults to the three
+ * EVENT_BUS_POOL_SM/MD/LG classes.
+ */
+#ifndef EVENT_BUS_POOL_TABLE
+#define EVENT_BUS_POOL_TABLE(X)                                                \
+  X(EVENT_BUS_POOL_SM_SZ, EVENT_BUS_POOL_SM_CT)                                \
+  X(EVENT_BUS_POOL_MD_SZ, EVENT_BUS_POOL_MD_CT)                                \
+  X(EVENT_BUS_POOL_LG_SZ, EVENT_BUS_POOL_LG_CT)
+#endif
+
+/* 1 for ISR-safe lock-free event pools, enables eventAllocFromISR */
+#ifndef EVENT_BUS_POOL_LOCKFREE
+#define EVENT_BUS_POOL_LOCKFREE 0
+#endif
+
+/* Blocks kept per core per pool in front of the shared free lists */
+#ifndef EVENT_BUS_POOL_CACHE_SZ
+#define EVENT_BUS_POOL_CACHE_SZ 0
+#endif
+
+#ifndef EVENT_BUS_CACHE_LINE
+#define EVENT_BUS_CACHE_LINE 32
+#endif
+
+#if EVENT_BUS_CMD_TRANSPORT == EVENT_BUS_TRANSPORT_RING &&                    \
+    (EVENT_BUS_MAX_CMD_QUEUE & (EVENT_BUS_MAX_CMD_QUEUE - 1)) != 0
+#error EVENT_BUS_MAX_CMD_QUEUE must be a power of two for the ring transport
+#endif
+
+/*
+ * Command lanes drained in strict priority order by the bus task, lane 0
+ * first. Subscription changes use lane 0, publishes use their event's lane
+ * set by eventSetLane, which defaults to the last one. Commands are only
+ * ordered within a lane.
+ */
+#ifndef EVENT_BUS_LANES
+#define EVENT_BUS_LANES 1
+#endif
+
+/*
+ * 1 to run non-retained publishEvent dispatch in the calling task instead
+ * of the bus task. Callbacks then run in the publisher's context, and as
+ * on the bus task they must not call the blocking bus functions.
+ *
+ * This gives up the default guarantee that every callback runs on the one
+ * bus task: with several publishers, the same callback can run in some of
+ * them and on the bus task at the same time, at each publisher's priority.
+ * Callbacks that share state then need their own locking. Off by default.
+ */
+#ifndef EVENT_BUS_DIRECT_DISPATCH
+#define EVENT_BUS_DIRECT_DISPATCH 0
+#endif
+
+/* Subscribers one direct publish can take, more go through the bus task */
+#ifndef EVENT_BUS_DIRECT_MAX_SUBS
+#define EVENT_BUS_DIRECT_MAX_SUBS 8
+#endif
+
+/*
+ * 1 for log2 latency histograms per event, and per listener when its
+ * hist points at storage. EVENT_BUS_TIME_SOURCE is then also read from
+ * ISRs and should be a cycle counter, DWT->CYCCNT on a Cortex-M3 or up.
+ */
+#ifndef EVENT_BUS_HIST
+#define EVENT_BUS_HIST 0
+#endif
+#ifndef EVENT_BUS_HIST_BUCKETS
+#define EVENT_BUS_HIST_BUCKETS 24
+#endif
+
+/*
+ * 0 drops publishTime from the event header, 8 bytes instead of 12 in
+ * every pool block, and with it the response times of eventResponseInfo.
+ */
+#ifndef EVENT_BUS_PUBLISH_TIME
+#define EVENT_BUS_PUBLISH_TIME 1
+#endif
+#if EVENT_BUS_HIST == 1 && EVENT_BUS_PUBLISH_TIME != 1
+#error EVENT_BUS_HIST needs EVENT_BUS_PUBLISH_TIME
+#endif
+
+/*
+ * Worker tasks running callbacks off the bus task, for listeners whose
+ * worker is set to 1..EVENT_BUS_WORKERS. Each worker has its own queue,
+ * so a listener's callbacks still run one at a time and in order, and
+ * may block or call the blocking bus functions. Only eventAlloc events
+ * are deferred; a static event has no reference to hold, so its callback
+ * still runs inline on the bus task. 0 keeps every callback inline.
+ */
+#ifndef EVENT_BUS_WORKERS
+#define EVENT_BUS_WORKERS 0
+#endif
+#ifndef EVENT_BUS_WORKER_STACK
+#define EVENT_BUS_WORKER_STACK (configMINIMAL_STACK_SIZE * 4)
+#endif
+/* Below the bus task, so dispatch preempts a running callback */
+#ifndef EVENT_BUS_WORKER_PRIORITY
+#define EVENT_BUS_WORKER_PRIORITY (EVENT_BUS_RTOS_PRIORITY - 1)
+#endif
+/* Callbacks one worker can have pending */
+#ifndef EVENT_BUS_WORKER_QUEUE
+#define EVENT_BUS_WORKER_QUEUE 16
+#endif
+/* Core mask for worker n, SMP builds with configUSE_CORE_AFFINITY only */
+#ifndef EVENT_BUS_WORKER_AFFINITY
+#define EVENT_BUS_WORKER_AFFINITY(n) tskNO_AFFINITY
+#endif
+
+/* 1 for the publish, delivery and queue depth counters in eventBusStats */
+#ifndef EVENT_BUS_STATS
+#define EVENT_BUS_STATS 0
+#endif
+
+/*
+ * 1 to keep the most recent publish, deliver, drop and release records
+ * in a binary ring, streamed with eventTraceRead and decoded on the host
+ * by tools/event_trace.py. EVENT_BUS_TRACE_SIZE must be a power of two.
+ */
+#ifndef EVENT_BUS_TRACE
+#define EVENT_BUS_TRACE 0
+#endif
+#ifndef EVENT_BUS_TRACE_SIZE
+#define EVENT_BUS_TRACE_SIZE 256
+#endif
+/* Read from ISRs as well, a free running cycle counter suits best */
+#ifndef EVENT_BUS_TRACE_TIME
+#define EVENT_BUS_TRACE_TIME EVENT_BUS_TIME_SOURCE
+#endif
+
+/* Total (listener, event) pairs the subscriber index can hold */
+#ifndef EVENT_BUS_MAX_SUBSCRIPTIONS
+#if EVENT_BUS_SPARSE == 1
+#define EVENT_BUS_MAX_SUBSCRIPTIONS (4 * EVENT_BUS_SPARSE_EVENTS)
+#else
+#define EVENT_BUS_MAX_SUBSCRIPTIONS (2 * EVENT_BUS_BITS)
+#endif
+#endif
 
 #if (EVENT_BUS_USE_TASK_NOTIFICATION_INDEX + 1) >                             \
     configTASK_NOTIFICATION_ARRAY_ENTRIES
@@ -53,47 +258,391 @@
     EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
 #endif
 
+/*
+ * Notification index eventReceiveBatch sleeps on, the ring owner should
+ * not use it for anything else. Defaults to the one after the bus's own,
+ * clear of index 0 that xTaskNotifyGive and waitingTask listeners use.
+ * Only ring consumers need configTASK_NOTIFICATION_ARRAY_ENTRIES to cover
+ * it, eventReceiveBatch asserts that.
+ */
+#ifndef EVENT_BUS_RING_NOTIFY_INDEX
+#ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
+#define EVENT_BUS_RING_NOTIFY_INDEX (EVENT_BUS_USE_TASK_NOTIFICATION_INDEX + 1)
+#else
+#define EVENT_BUS_RING_NOTIFY_INDEX 1
+#endif
+#endif
+
+/*
+ * Naturally aligned and free of bitfields, so updating one field never
+ * rewrites its neighbours, refCount least of all.
+ */
 typedef struct {
-  uint32_t event;
+  uint16_t event;
+  uint16_t publisherId;
+#if EVENT_BUS_PUBLISH_TIME == 1
   uint32_t publishTime;
+#endif
   volatile uint16_t refCount;
-  uint16_t publisherId : 12;
-  uint16_t dynamicAlloc : 3;
-  uint16_t published : 1;
+  uint8_t dynamicAlloc;
+  uint8_t published;
 } event_t;
 
+/*
+ * Per-listener delivery ring, read with eventReceiveBatch by the owning
+ * task. size must be a power of two, slots holds size pointers.
+ */
+typedef struct {
+  event_t **slots;
+  uint32_t size;
+  volatile uint32_t head;
+  volatile uint32_t tail;
+  TaskHandle_t volatile waiting;
+} event_ring_t;
+#define EVENT_RING_INIT(storage)                                               \
+  { .slots = (storage), .size = sizeof(storage) / sizeof((storage)[0]) }
+
+/*
+ * Staging ring for one interrupt source, filled by publishEventStaged and
+ * drained by the bus in one go. Only one ISR may push to a stage. size
+ * must be a power of two, slots holds size pointers.
+ */
+typedef struct {
+  event_t **slots;
+  uint32_t size;
+  volatile uint32_t head;
+  volatile uint32_t tail;
+  volatile uint32_t kicked;
+} event_isr_stage_t;
+#define EVENT_ISR_STAGE_INIT(storage) EVENT_RING_INIT(storage)
+
+#if EVENT_BUS_HIST == 1
+/*
+ * Counts in EVENT_BUS_TIME_SOURCE units. Bucket b holds deltas in
+ * [2^(b-1), 2^b), bucket 0 holds zero and the last one everything above.
+ */
+typedef struct {
+  /* Command sent to dispatch start, per event only */
+  volatile uint32_t queue[EVENT_BUS_HIST_BUCKETS];
+  /* Whole fan-out per event, the single delivery per listener */
+  volatile uint32_t dispatch[EVENT_BUS_HIST_BUCKETS];
+  /* Dispatch start to eventRelease */
+  volatile uint32_t hold[EVENT_BUS_HIST_BUCKETS];
+} event_hist_t;
+#endif
+
+/*
+ * What a queue or ring listener does with an event it has no room for.
+ * Every dropped event counts in the listener stats whatever the policy.
+ */
+typedef enum {
+  /* Drop the new event and call EVENT_BUS_DEBUG_QUEUE_FULL */
+  EVENT_OVERFLOW_REPORT = 0,
+  /* Drop the new event quietly */
+  EVENT_OVERFLOW_DROP_NEWEST,
+  /* Queue listeners only, drop the oldest pending event instead */
+  EVENT_OVERFLOW_DROP_OLDEST,
+  /*
+   * Wait up to overflowWait for room. This stalls the bus task, or the
+   * publisher on direct dispatch, so keep the wait short.
+   */
+  EVENT_OVERFLOW_BLOCK,
+  /* Queue listeners only, replace a pending event with the same ID */
+  EVENT_OVERFLOW_CONFLATE,
+} event_overflow_t;
+
+/* Filter comparisons, unsigned unless EVENT_FILTER_SIGNED is or'ed in */
+typedef enum {
+  EVENT_FILTER_EQ,
+  EVENT_FILTER_NE,
+  EVENT_FILTER_GT,
+  EVENT_FILTER_GE,
+  EVENT_FILTER_LT,
+  EVENT_FILTER_LE,
+} event_filter_op_t;
+#define EVENT_FILTER_SIGNED 0x80
+
+/*
+ * Content filter for one subscription, checked before each delivery so
+ * rejected events cost the listener no queue slot, reference or wakeup.
+ * With match set it decides, otherwise the 1, 2 or 4 byte field at
+ * offset into the event is masked and compared with value. Either way it
+ * runs wherever dispatch does, the bus task or a direct publisher, and
+ * must not block.
+ */
+typedef struct EVENT_FILTER_T {
+  bool (*match)(const event_t *ev, void *ctx);
+  void *ctx;
+  uint16_t offset;
+  uint8_t width;
+  uint8_t op; /* event_filter_op_t */
+  uint32_t mask;
+  uint32_t value;
+  /* Owned by the bus */
+  uint32_t eventId;
+  struct EVENT_FILTER_T *next;
+} event_filter_t;
+/* Compares member of the payload struct type, for example a CAN ID */
+#define EVENT_FILTER_FIELD(type, member, cmp, val)                             \
+  { .offset = offsetof(type, member),                                          \
+    .width = sizeof(((type *)0)->member), .op = (cmp),                         \
+    .mask = 0xFFFFFFFFUL, .value = (uint32_t)(val) }
+
+struct SUB_NODE_T;
+
+/*
+ * Dispatch goes through the subscriber index, so only the fields up to
+ * delivered are touched per delivery. They lead the struct to share a
+ * cache line, the subscription masks and list links come after.
+ */
 struct LISTENER_T {
-  uint32_t eventMask[EVENT_BUS_MASK_WIDTH];
-  uint32_t refCount : 16; /* Debug helper */
-  uint32_t errFull : 1;
   void (*callback)(event_t *ev);
   QueueHandle_t queueHandle;
+  event_ring_t *ring;
   TaskHandle_t waitingTask;
+  volatile uint16_t refCount; /* Debug helper */
+  uint8_t overflow; /* event_overflow_t */
+  uint8_t errFull;
+#if EVENT_BUS_WORKERS > 0
+  /*
+   * 1 based worker that runs callback for eventAlloc events, 0 or a static
+   * event runs it inline. A full worker queue follows overflow, where only
+   * BLOCK differs from dropping.
+   */
+  uint8_t worker;
+#endif
+#if EVENT_BUS_HIST == 1
+  /* Optional, NULL skips the per-listener histograms */
+  event_hist_t *hist;
+#endif
+#if EVENT_BUS_STATS == 1
+  volatile uint32_t delivered;
+  volatile uint32_t dropped;
+#endif
+  TickType_t overflowWait;
   const char * name;
   struct LISTENER_T *prev;
   struct LISTENER_T *next;
+  /* Owned by the bus, see subEventFiltered */
+  event_filter_t *filters;
+#if EVENT_BUS_SPARSE == 1
+  /* Owned by the bus, kept across detach like the dense masks */
+  struct SUB_NODE_T *subs;
+#else
+  uint32_t eventMask[EVENT_BUS_MASK_WIDTH];
+  /* Subscriptions where a newer event replaces a queued one */
+  uint32_t conflateMask[EVENT_BUS_MASK_WIDTH];
+#endif
 };
 typedef struct LISTENER_T event_listener_t;
 
+/* Runs on the bus task after dispatch, ev may be freed once it returns */
+typedef void (*event_complete_t)(event_t *ev);
+
+/* Runs in whichever context drops the last reference */
+typedef void (*event_ext_release_t)(void *data, void *ctx);
+
+/*
+ * Event referring to a buffer it does not own, such as a DMA region. The
+ * header is pool allocated and refcounted like any eventAlloc event, and
+ * release hands the buffer back once the last subscriber is done.
+ */
+typedef struct {
+  event_t e;
+  void *data;
+  size_t len;
+  event_ext_release_t release;
+  void *ctx;
+} event_ext_t;
+
 TaskHandle_t initEventBus(void);
 void subEvent(event_listener_t *listener, uint32_t eventId);
 void subEventList(event_listener_t *listener, const uint32_t *eventList);
+#if EVENT_BUS_SPARSE != 1
+/* ORs a whole mask in with one bus command */
+void subEventMask(event_listener_t *listener,
+                  const uint32_t mask[EVENT_BUS_MASK_WIDTH]);
+#endif
+/* Subscribes first..last inclusive */
+void subEventRange(event_listener_t *listener, uint32_t first, uint32_t last);
+/* Queue listeners only, keeps at most the newest eventId pending */
+void subEventConflated(event_listener_t *listener, uint32_t eventId);
+/*
+ * Subscribes eventId, delivering only events filter passes. filter is
+ * the caller's and must stay valid, and not be shared, until unSubEvent.
+ * Subscribing the ID with another filter replaces it.
+ */
+void subEventFiltered(event_listener_t *listener, uint32_t eventId,
+                      event_filter_t *filter);
 void unSubEvent(event_listener_t *listener, uint32_t eventId);
+/*
+ * Drops every subscription. With EVENT_BUS_SPARSE they are held in bus
+ * nodes, so call this before a listener goes out of scope.
+ */
+void unSubEventAll(event_listener_t *listener);
 void attachBus(event_listener_t *listener);
 void detachBus(event_listener_t *listener);
+/*
+ * Queue the command and return without waiting for the bus, so they can
+ * be used from bus callbacks, where xTicksToWait is forced to 0. They run
+ * in call order before any publish sent afterwards. The listener must
+ * stay valid until the command has run, see eventBusBarrier.
+ */
+BaseType_t attachBusAsync(event_listener_t *listener, TickType_t xTicksToWait);
+BaseType_t subEventAsync(event_listener_t *listener, uint32_t eventId,
+                         TickType_t xTicksToWait);
+BaseType_t detachBusAsync(event_listener_t *listener, TickType_t xTicksToWait);
+/*
+ * Returns once every command sent before it has been processed, on every
+ * lane. Costs one round trip per lane.
+ */
+void eventBusBarrier(void);
+#if EVENT_BUS_WORKERS > 0
+/*
+ * Returns once every callback handed to a worker before the call has
+ * run. detachBus does this for the listener's worker, detachBusAsync
+ * callers need it before the listener goes away. Not from a worker.
+ */
+void eventWorkerFlush(void);
+#endif
+/* A retained dynamic event stays allocated until replaced or invalidated */
 void publishEvent(event_t *ev, bool retain);
+/* Dispatches evs[0..n-1] in order for one bus round trip, never retained */
+void publishEventBatch(event_t *const *evs, size_t n);
+/*
+ * Queues an eventAlloc event and returns without waiting for dispatch.
+ * The bus owns ev on every return: on pdFAIL, when no command slot freed
+ * up within xTicksToWait, it has already been freed and onComplete is not
+ * called, so the caller must not touch or release it either way.
+ */
+BaseType_t publishEventAsync(event_t *ev, event_complete_t onComplete,
+                             TickType_t xTicksToWait);
 BaseType_t publishToListener(event_listener_t *listener, event_t *ev,
                              TickType_t xTicksToWait);
-BaseType_t publishEventFromISR(event_t *ev);
+/*
+ * pxHigherPriorityTaskWoken follows the FreeRTOS FromISR convention, it
+ * may be NULL, otherwise pass it to portYIELD_FROM_ISR.
+ */
+BaseType_t publishEventFromISR(event_t *ev,
+                               BaseType_t *pxHigherPriorityTaskWoken);
+/*
+ * Queues ev on the stage without a bus command, only the push that finds
+ * the stage idle sends one. pdFALSE if the stage is full. Staged events
+ * are dispatched on lane 0, never retained.
+ */
+BaseType_t publishEventStaged(event_isr_stage_t *stage, event_t *ev,
+                              BaseType_t *pxHigherPriorityTaskWoken);
 void invalidateEvent(event_t *ev);
+void eventSetLane(uint32_t eventId, uint32_t lane);
 #ifdef EVENT_BUS_USE_TASK_NOTIFICATION_INDEX
 BaseType_t waitEvent(uint32_t event, uint32_t waitTicks);
 #endif
 void *eventAlloc(size_t size, uint32_t eventId, uint16_t publisherId);
+#if EVENT_BUS_POOL_LOCKFREE == 1
+/* Returns NULL instead of asserting when the pool is exhausted */
+void *eventAllocFromISR(size_t size, uint32_t eventId, uint16_t publisherId);
+#endif
+/* Returns NULL instead of asserting when the pool is exhausted */
+void *eventTryAlloc(size_t size, uint32_t eventId, uint16_t publisherId);
+/*
+ * Free blocks in the class eventAlloc(size) would draw from, 0 if no
+ * class fits. A snapshot, other tasks may take them before the caller.
+ * Counts the calling core's cache only, so on SMP it is a lower bound
+ * and low-water callbacks fire early rather than late.
+ */
+uint32_t eventPoolFree(size_t size);
+/* blockSize is the class's block size, low tells which way it crossed */
+typedef void (*event_pool_low_t)(size_t blockSize, bool low);
+/*
+ * Calls onLow(blockSize, true) once the class eventAlloc(size) draws from
+ * is down to level free blocks, and onLow(blockSize, false) once it is
+ * back above, so producers can throttle before allocations fail. It runs
+ * in whichever context allocated or freed, ISRs included, so keep it to
+ * a flag or a notification. level 0 stops watching the class.
+ */
+void eventPoolSetLowWater(size_t size, uint32_t level, event_pool_low_t onLow);
+event_ext_t *eventAllocExt(uint32_t eventId, uint16_t publisherId, void *data,
+                           size_t len, event_ext_release_t release,
+                           void *ctx);
 void eventRelease(event_t *ev, event_listener_t *listener);
+void eventReleaseBatch(event_t *const *evs, size_t n,
+                       event_listener_t *listener);
+/* Takes up to max pending events from listener->ring, 0 on timeout */
+size_t eventReceiveBatch(event_listener_t *listener, event_t **out, size_t max,
+                         TickType_t xTicksToWait);
 /* Debugging aids */
 uint32_t eventListenerInfo(char *const buf, uint32_t bufLen);
 uint32_t eventResponseInfo(char *const buf, uint32_t bufLen);
+#if EVENT_BUS_HIST == 1
+/* Copies the event's histograms without clearing, pdFAIL if none kept */
+BaseType_t eventHistSnapshot(uint32_t eventId, event_hist_t *out);
+#endif
+#if EVENT_BUS_STATS == 1
+/*
+ * Binary counterparts of the info tables, for streaming without text
+ * formatting. Counters are free running, none of these reset anything.
+ */
+typedef struct {
+  uint32_t publishes;
+  /* Same units as eventResponseInfo, which still resets them */
+  uint32_t minResponse;
+  uint32_t maxResponse;
+} event_stats_t;
+
+typedef struct {
+  uint32_t delivered;
+  /* Deliveries lost to a full queue or ring */
+  uint32_t dropped;
+  /* Pool events handed over and not yet released */
+  uint32_t inFlight;
+} event_listener_stats_t;
+
+typedef struct {
+  uint32_t laneCommands[EVENT_BUS_LANES];
+  /* Deepest each lane has been when the bus took a command */
+  uint32_t laneHighWater[EVENT_BUS_LANES];
+  /* Commands that found the transport full */
+  uint32_t cmdSendFails;
+  uint32_t batchMax;
+} event_bus_stats_t;
+
+/* pdFAIL if no record is kept for eventId */
+BaseType_t eventStatsSnapshot(uint32_t eventId, event_stats_t *out);
+void eventListenerStats(const event_listener_t *listener,
+                        event_listener_stats_t *out);
+void eventBusStats(event_bus_stats_t *out);
+#endif
+#if EVENT_BUS_TRACE == 1
+typedef enum {
+  EVENT_TRACE_PUBLISH = 1,
+  EVENT_TRACE_DELIVER,
+  /* Full queue or ring, follows the DELIVER record of the attempt */
+  EVENT_TRACE_DROP,
+  /* Also written when conflation supersedes a queued event */
+  EVENT_TRACE_RELEASE,
+} event_trace_type_t;
+
+/* 16 bytes in target byte order, layout shared with the decoder */
+typedef struct {
+  uint32_t time;
+  /* Low 32 bits of the addresses, listener is 0 for publishes */
+  uint32_t event;
+  uint32_t listener;
+  uint16_t eventId;
+  uint8_t type;
+  /* Low bits of the record number, a gap means records were lost */
+  uint8_t seq;
+} event_trace_rec_t;
+
+/*
+ * Copies up to max records from *cursor onwards and advances it, returns
+ * the count. Start the cursor at 0; records already overwritten are
+ * skipped, and one still being written ends the read early.
+ */
+uint32_t eventTraceRead(uint32_t *cursor, event_trace_rec_t *out,
+                        uint32_t max);
+#endif
 uint32_t eventPoolInfo(char *const buf, uint32_t bufLen);
+uint32_t eventBatchInfo(char *const buf, uint32_t bufLen);
 
 #endif /* EVENTBUS_H */
\ No newline at end of file
@@ -0,0 +1,239 @@
+/**
+ * MIT License
+ *
+ * Copyright (c) 2022 Erik Friesen
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef EVENTBUS_PORT_H
+#define EVENTBUS_PORT_H
+
+/*
+ * Private helpers for the bus internals, not part of the public API.
+ * All atomics are sequentially consistent and return the previous value.
+ * Native compare-and-swap is used where the compiler has it for the
+ * target, otherwise FreeRTOS atomic.h, which masks interrupts instead.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <FreeRTOS.h>
+
+/* Core count and current core, for per-core data on SMP builds */
+#if defined(configNUMBER_OF_CORES) && (configNUMBER_OF_CORES > 1)
+#define EVENT_BUS_NUM_CORES configNUMBER_OF_CORES
+#define EVENT_BUS_CORE_ID() portGET_CORE_ID()
+#elif defined(configNUM_CORES) && (configNUM_CORES > 1)
+#define EVENT_BUS_NUM_CORES configNUM_CORES
+#define EVENT_BUS_CORE_ID() portGET_CORE_ID()
+#else
+#define EVENT_BUS_NUM_CORES 1
+#define EVENT_BUS_CORE_ID() 0
+#endif
+
+/* Index of the lowest set bit, x must not be 0 */
+#if defined(__GNUC__)
+#define EVENT_BUS_CTZ(x) ((uint32_t)__builtin_ctz(x))
+#elif defined(_MSC_VER)
+#include <intrin.h>
+static inline uint32_t ebCtz(uint32_t x) {
+  unsigned long i;
+  (void)_BitScanForward(&i, x);
+  return (uint32_t)i;
+}
+#define EVENT_BUS_CTZ(x) ebCtz(x)
+#else
+static inline uint32_t ebCtz(uint32_t x) {
+  uint32_t i = 0;
+  while ((x & 1) == 0) {
+    x >>= 1;
+    i++;
+  }
+  return i;
+}
+#define EVENT_BUS_CTZ(x) ebCtz(x)
+#endif
+
+/* Leading zero bits, x must not be 0 */
+#if defined(__GNUC__)
+#define EVENT_BUS_CLZ(x) ((uint32_t)__builtin_clz(x))
+#elif defined(_MSC_VER)
+static inline uint32_t ebClz(uint32_t x) {
+  unsigned long i;
+  (void)_BitScanReverse(&i, x);
+  return 31 - (uint32_t)i;
+}
+#define EVENT_BUS_CLZ(x) ebClz(x)
+#else
+static inline uint32_t ebClz(uint32_t x) {
+  uint32_t n = 0;
+  while ((x & 0x80000000UL) == 0) {
+    x <<= 1;
+    n++;
+  }
+  return n;
+}
+#define EVENT_BUS_CLZ(x) ebClz(x)
+#endif
+
+#if defined(__GNUC__)
+#define EVENT_BUS_ALIGNED(n) __attribute__((aligned(n)))
+#elif defined(_MSC_VER)
+#define EVENT_BUS_ALIGNED(n) __declspec(align(n))
+#else
+#define EVENT_BUS_ALIGNED(n)
+#endif
+
+#if defined(__GNUC__) && defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_4) &&       \
+    defined(__GCC_HAVE_SYNC_COMPARE_AND_SWAP_2)
+
+static inline uint32_t ebAtomicLoad(volatile uint32_t *p) {
+  return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+static inline void ebAtomicStore(volatile uint32_t *p, uint32_t v) {
+  __atomic_store_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+static inline bool ebAtomicCas(volatile uint32_t *p, uint32_t expected,
+                               uint32_t desired) {
+  return __atomic_compare_exchange_n(p, &expected, desired, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t ebAtomicAdd(volatile uint32_t *p, uint32_t v) {
+  return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST);
+}
+
+static inline uint32_t ebAtomicSub(volatile uint32_t *p, uint32_t v) {
+  return __atomic_fetch_sub(p, v, __ATOMIC_SEQ_CST);
+}
+
+static inline uint16_t ebAtomicAdd16(volatile uint16_t *p, uint16_t v) {
+  return __atomic_fetch_add(p, v, __ATOMIC_SEQ_CST);
+}
+
+static inline uint16_t ebAtomicSub16(volatile uint16_t *p, uint16_t v) {
+  return __atomic_fetch_sub(p, v, __ATOMIC_SEQ_CST);
+}
+
+static inline void *ebAtomicLoadPtr(void *volatile *p) {
+  return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+static inline void ebAtomicStorePtr(void *volatile *p, void *v) {
+  __atomic_store_n(p, v, __ATOMIC_SEQ_CST);
+}
+
+#elif defined(_MSC_VER)
+
+#include <intrin.h>
+
+static inline uint32_t ebAtomicLoad(volatile uint32_t *p) {
+  return (uint32_t)_InterlockedOr((volatile long *)p, 0);
+}
+
+static inline void ebAtomicStore(volatile uint32_t *p, uint32_t v) {
+  (void)_InterlockedExchange((volatile long *)p, (long)v);
+}
+
+static inline bool ebAtomicCas(volatile uint32_t *p, uint32_t expected,
+                               uint32_t desired) {
+  return (uint32_t)_InterlockedCompareExchange(
+             (volatile long *)p, (long)desired, (long)expected) == expected;
+}
+
+static inline uint32_t ebAtomicAdd(volatile uint32_t *p, uint32_t v) {
+  return (uint32_t)_InterlockedExchangeAdd((volatile long *)p, (long)v);
+}
+
+static inline uint32_t ebAtomicSub(volatile uint32_t *p, uint32_t v) {
+  return (uint32_t)_InterlockedExchangeAdd((volatile long *)p, -(long)v);
+}
+
+static inline uint16_t ebAtomicAdd16(volatile uint16_t *p, uint16_t v) {
+  return (uint16_t)_InterlockedExchangeAdd16((volatile short *)p, (short)v);
+}
+
+static inline uint16_t ebAtomicSub16(volatile uint16_t *p, uint16_t v) {
+  return (uint16_t)_InterlockedExchangeAdd16((volatile short *)p, -(short)v);
+}
+
+static inline void *ebAtomicLoadPtr(void *volatile *p) {
+  return _InterlockedCompareExchangePointer(p, NULL, NULL);
+}
+
+static inline void ebAtomicStorePtr(void *volatile *p, void *v) {
+  (void)_InterlockedExchangePointer(p, v);
+}
+
+#else
+
+#include <atomic.h>
+
+static inline uint32_t ebAtomicLoad(volatile uint32_t *p) { return *p; }
+
+static inline void ebAtomicStore(volatile uint32_t *p, uint32_t v) { *p = v; }
+
+static inline bool ebAtomicCas(volatile uint32_t *p, uint32_t expected,
+                               uint32_t desired) {
+  return Atomic_CompareAndSwap_u32(p, desired, expected) ==
+         ATOMIC_COMPARE_AND_SWAP_SUCCESS;
+}
+
+static inline uint32_t ebAtomicAdd(volatile uint32_t *p, uint32_t v) {
+  return Atomic_Add_u32(p, v);
+}
+
+static inline uint32_t ebAtomicSub(volatile uint32_t *p, uint32_t v) {
+  return Atomic_Subtract_u32(p, v);
+}
+
+/* atomic.h has no 16 bit forms, use its critical section directly */
+static inline uint16_t ebAtomicAdd16(volatile uint16_t *p, uint16_t v) {
+  uint16_t prev;
+  ATOMIC_ENTER_CRITICAL();
+  {
+    prev = *p;
+    *p = prev + v;
+  }
+  ATOMIC_EXIT_CRITICAL();
+  return prev;
+}
+
+static inline uint16_t ebAtomicSub16(volatile uint16_t *p, uint16_t v) {
+  uint16_t prev;
+  ATOMIC_ENTER_CRITICAL();
+  {
+    prev = *p;
+    *p = prev - v;
+  }
+  ATOMIC_EXIT_CRITICAL();
+  return prev;
+}
+
+/* Aligned pointer accesses are single copy atomic on FreeRTOS targets */
+static inline void *ebAtomicLoadPtr(void *volatile *p) { return *p; }
+
+static inline void ebAtomicStorePtr(void *volatile *p, void *v) { *p = v; }
+
+#endif
+
+#endif /* EVENTBUS_PORT_H */
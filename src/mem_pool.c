@@ -21,6 +21,7 @@
 #include <stdint.h>
 
 #include "mem_pool.h"
+#include "event_bus_port.h"
 
 struct block {
   void *next;
@@ -100,3 +101,89 @@ uint32_t mp_integrity(mp_pool_t *mp, mp_info_t *info) {
   // Does it match count?
   return 1;
 }
+
+/* EF - lock-free variant */
+#define MP_LF_NONE 0xFFFFUL
+#define MP_LF_INDEX(h) ((h) & 0xFFFFUL)
+#define MP_LF_TAG(h) ((h) >> 16)
+#define MP_LF_HEAD(tag, index) ((((uint32_t)(tag)) << 16) | (index))
+
+struct lf_block {
+  uint32_t next; // index of the next free block
+};
+
+static inline struct lf_block *mp_lf_block(mp_lf_pool_t *mp, uint32_t i) {
+  return (struct lf_block *)&((uint8_t *)mp->start)[mp->bs * i];
+}
+
+int mp_lf_init(size_t bs, size_t bc, void *m, mp_lf_pool_t *mp) {
+  uint32_t i;
+  if (bs < sizeof(uint32_t) || bs % sizeof(uint32_t) != 0 ||
+      bc >= MP_LF_NONE) {
+    return -1;
+  }
+  mp->bs = bs;
+  mp->initialBlocks = bc;
+  mp->start = m;
+  mp->end = (void *)&((uint8_t *)m)[bs * bc];
+  mp->high_water = 0;
+  mp->count = 0;
+  /* No lazy carving here, it would need a second shared cursor */
+  for (i = 0; i < bc; i++) {
+    mp_lf_block(mp, i)->next = (i + 1 < bc) ? i + 1 : MP_LF_NONE;
+  }
+  mp->head = MP_LF_HEAD(0, bc ? 0 : MP_LF_NONE);
+  return 0;
+}
+
+void *mp_lf_malloc(mp_lf_pool_t *mp) {
+  uint32_t head, next, hw, count;
+  struct lf_block *b;
+  do {
+    head = ebAtomicLoad(&mp->head);
+    if (MP_LF_INDEX(head) == MP_LF_NONE) {
+      return NULL;
+    }
+    b = mp_lf_block(mp, MP_LF_INDEX(head));
+    /* May be stale if b was taken meanwhile, the tag makes the CAS fail */
+    next = b->next;
+  } while (!ebAtomicCas(&mp->head, head,
+                        MP_LF_HEAD(MP_LF_TAG(head) + 1, next)));
+  count = ebAtomicAdd(&mp->count, 1) + 1;
+  hw = ebAtomicLoad(&mp->high_water);
+  while (count > hw && !ebAtomicCas(&mp->high_water, hw, count)) {
+    hw = ebAtomicLoad(&mp->high_water);
+  }
+  return b;
+}
+
+void mp_lf_free(mp_lf_pool_t *mp, void *b) {
+  uint32_t head;
+  uint32_t index = ((uint8_t *)b - (uint8_t *)mp->start) / mp->bs;
+  do {
+    head = ebAtomicLoad(&mp->head);
+    ((struct lf_block *)b)->next = MP_LF_INDEX(head);
+  } while (!ebAtomicCas(&mp->head, head,
+                        MP_LF_HEAD(MP_LF_TAG(head) + 1, index)));
+  (void)ebAtomicSub(&mp->count, 1);
+}
+
+uint32_t mp_lf_integrity(mp_lf_pool_t *mp, mp_info_t *info) {
+  uint32_t i = MP_LF_INDEX(ebAtomicLoad(&mp->head));
+  info->freeCount = 0;
+  info->high_water = mp->high_water;
+  info->count = mp->count;
+  info->blockCount = mp->initialBlocks;
+  // Walk the free list, only exact when nothing else is using the pool
+  while (i != MP_LF_NONE) {
+    if (i >= mp->initialBlocks || info->freeCount > mp->initialBlocks) {
+      return 0;
+    }
+    info->freeCount++;
+    i = mp_lf_block(mp, i)->next;
+  }
+  if (mp->initialBlocks - info->count != info->freeCount) {
+    return 0;
+  }
+  return 1;
+}
@@ -66,4 +66,38 @@ void mp_free(mp_pool_t *mp, void *b);
 
 uint32_t mp_integrity(mp_pool_t *mp, mp_info_t *info);
 
+/*
+ * Lock-free variant, usable from tasks and ISRs at the same time.
+ * All blocks are linked at init, the head packs a 16 bit block index
+ * with a 16 bit ABA tag so it can be swapped with a single 32 bit CAS.
+ */
+struct mp_lf_data {
+  size_t bs;               // the size of a block from the memory pool
+  uint32_t initialBlocks;  // at most 0xFFFF
+  volatile uint32_t head;  // (tag << 16) | index of the first free block
+  volatile uint32_t high_water;
+  volatile uint32_t count;
+  void *start;
+  void *end;
+};
+
+typedef struct mp_lf_data mp_lf_pool_t;
+
+/*
+ * Initialize the lock-free pool, bs must hold and align a uint32_t
+ */
+int mp_lf_init(size_t bs, size_t bc, void *m, mp_lf_pool_t *mp);
+
+/*
+ * Pop a free block, NULL when the pool is exhausted
+ */
+void *mp_lf_malloc(mp_lf_pool_t *mp);
+
+/*
+ * Push b back on the free list
+ */
+void mp_lf_free(mp_lf_pool_t *mp, void *b);
+
+uint32_t mp_lf_integrity(mp_lf_pool_t *mp, mp_info_t *info);
+
 #endif /* MEMPOOL_H */
\ No newline at end of file
@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""Compare two event bus benchmark runs and flag regressions.
+
+Both inputs are the JSON lines eventBusBench prints, other lines such as
+simulator chatter are ignored. Results are matched on bench and param,
+and the exit status is 1 when any metric got slower than --threshold.
+"""
+
+import argparse
+import json
+import sys
+
+
+def load(path):
+    results = {}
+    config = None
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line.startswith("{"):
+                continue
+            try:
+                rec = json.loads(line)
+            except ValueError:
+                continue
+            if rec.get("bench") == "config":
+                config = rec
+            elif "bench" in rec:
+                results[(rec["bench"], rec["param"])] = rec
+    return config, results
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("baseline")
+    ap.add_argument("candidate")
+    ap.add_argument("--metric", default="p50",
+                    choices=["min", "p50", "p99", "max", "mean"])
+    ap.add_argument("--threshold", type=float, default=10.0,
+                    help="percent slowdown reported as a regression")
+    args = ap.parse_args()
+
+    base_cfg, base = load(args.baseline)
+    cand_cfg, cand = load(args.candidate)
+    if base_cfg and cand_cfg:
+        diff = {k for k in base_cfg if base_cfg.get(k) != cand_cfg.get(k)}
+        if diff:
+            print("warning: configs differ in %s" % ", ".join(sorted(diff)))
+
+    regressions = 0
+    print("%-24s %6s %10s %10s %8s" % ("bench", "param", "base", "cand",
+                                       "change"))
+    for key in sorted(set(base) & set(cand)):
+        old = base[key][args.metric]
+        new = cand[key][args.metric]
+        change = (new - old) * 100.0 / old if old else 0.0
+        flag = ""
+        if change > args.threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        print("%-24s %6d %10d %10d %+7.1f%%%s" % (key[0], key[1], old, new,
+                                                  change, flag))
+    for key in sorted(set(base) ^ set(cand)):
+        print("%-24s %6d only in %s" % (key[0], key[1],
+                                        "baseline" if key in base else
+                                        "candidate"))
+    return 1 if regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
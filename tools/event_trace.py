@@ -0,0 +1,142 @@
+#!/usr/bin/env python3
+"""Decode event bus trace records captured with eventTraceRead.
+
+The input is the raw event_trace_rec_t array as it was copied out of the
+target, concatenated across reads. Each record is 16 bytes:
+
+    uint32 time, uint32 event, uint32 listener,
+    uint16 eventId, uint8 type, uint8 seq
+
+Prints one line per record, then publish to deliver and deliver to
+release latency per event ID, with the worst cases for each.
+"""
+
+import argparse
+import struct
+import sys
+
+REC = struct.Struct("<IIIHBB")
+TYPES = {1: "PUBLISH", 2: "DELIVER", 3: "DROP", 4: "RELEASE"}
+MASK = 0xFFFFFFFF
+
+
+class Phase:
+    def __init__(self):
+        self.samples = []
+
+    def add(self, delta, rec_index):
+        self.samples.append((delta, rec_index))
+
+    def summary(self, scale, top):
+        values = [d for d, _ in self.samples]
+        worst = sorted(self.samples, reverse=True)[:top]
+        return "n=%d min=%s avg=%s max=%s worst=%s" % (
+            len(values),
+            fmt(min(values), scale),
+            fmt(sum(values) / len(values), scale),
+            fmt(max(values), scale),
+            ",".join("#%d" % i for _, i in worst),
+        )
+
+
+def fmt(value, scale):
+    if scale is None:
+        return "%g" % value
+    return "%.3fus" % (value * scale)
+
+
+def parse_names(items):
+    names = {}
+    for item in items:
+        addr, _, name = item.partition("=")
+        names[int(addr, 16) & MASK] = name
+    return names
+
+
+def decode(data, endian):
+    rec = struct.Struct(endian + REC.format[1:])
+    usable = len(data) - len(data) % rec.size
+    if usable != len(data):
+        sys.stderr.write("ignoring %d trailing bytes\n" % (len(data) - usable))
+    return [rec.unpack_from(data, off) for off in range(0, usable, rec.size)]
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("file", help="raw trace dump, - for stdin")
+    ap.add_argument("--big-endian", action="store_true",
+                    help="target stores records big endian")
+    ap.add_argument("--us-per-tick", type=float,
+                    help="EVENT_BUS_TRACE_TIME period, prints microseconds")
+    ap.add_argument("--name", action="append", default=[],
+                    metavar="ADDR=NAME",
+                    help="label a listener address, may repeat")
+    ap.add_argument("--top", type=int, default=3,
+                    help="worst records listed per event ID")
+    ap.add_argument("--summary", action="store_true",
+                    help="skip the per-record listing")
+    args = ap.parse_args()
+
+    if args.file == "-":
+        data = sys.stdin.buffer.read()
+    else:
+        with open(args.file, "rb") as f:
+            data = f.read()
+    recs = decode(data, ">" if args.big_endian else "<")
+    names = parse_names(args.name)
+    scale = args.us_per_tick
+
+    published = {}
+    delivered = {}
+    queue = {}
+    hold = {}
+    drops = {}
+    lost = 0
+    prev_seq = None
+    first_time = recs[0][0] if recs else 0
+
+    for i, (time, event, listener, event_id, kind, seq) in enumerate(recs):
+        if prev_seq is not None and seq != (prev_seq + 1) & 0xFF:
+            gap = (seq - prev_seq - 1) & 0xFF
+            lost += gap
+            if not args.summary:
+                print("-- %d records lost (at least) --" % gap)
+        prev_seq = seq
+        name = TYPES.get(kind, "TYPE%d" % kind)
+        if not args.summary:
+            who = names.get(listener, "%08x" % listener) if listener else ""
+            print(("#%-6d %12s  %-7s id=%-5d ev=%08x %s" % (
+                i, fmt((time - first_time) & MASK, scale), name, event_id,
+                event, who)).rstrip())
+        if kind == 1:
+            published[event] = time
+        elif kind == 2:
+            if event in published:
+                queue.setdefault(event_id, Phase()).add(
+                    (time - published[event]) & MASK, i)
+            delivered[(event, listener)] = time
+        elif kind == 3:
+            delivered.pop((event, listener), None)
+            drops[event_id] = drops.get(event_id, 0) + 1
+        elif kind == 4:
+            start = delivered.pop((event, listener), None)
+            if start is not None:
+                hold.setdefault(event_id, Phase()).add(
+                    (time - start) & MASK, i)
+
+    print("%d records, %d lost" % (len(recs), lost))
+    for event_id in sorted(set(queue) | set(hold) | set(drops)):
+        print("id %d" % event_id)
+        if event_id in queue:
+            print("  publish->deliver " + queue[event_id].summary(scale,
+                                                                  args.top))
+        if event_id in hold:
+            print("  deliver->release " + hold[event_id].summary(scale,
+                                                                 args.top))
+        if event_id in drops:
+            print("  dropped %d" % drops[event_id])
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())